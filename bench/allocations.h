@@ -0,0 +1,10 @@
+#ifndef __LITEVIZ_BENCH_ALLOCATIONS_H__
+#define __LITEVIZ_BENCH_ALLOCATIONS_H__
+
+#include <cstddef>
+
+// heap allocations made by the process so far, through the global operator
+// new that allocations.cpp replaces; steady frames should not add any
+size_t heap_allocations();
+
+#endif // __LITEVIZ_BENCH_ALLOCATIONS_H__
@@ -0,0 +1,654 @@
+#include <liteviz/core/headless.h>
+#include <liteviz/core/mesh.h>
+#include <liteviz/core/frustum_set.h>
+#include <liteviz/core/image.h>
+#include <liteviz/core/workload.h>
+
+#include "allocations.h"
+
+#include <random>
+
+using namespace liteviz;
+
+// liteviz-bench: offscreen throughput numbers to diff between versions.
+// Every case adds one entry of named parameters and metrics to a JSON report
+// on stdout (or --out). Times are wall clock in ms around glFinish(), so they
+// include the GPU work; GL work comes from gl_counters() and heap allocations
+// from the replaced operator new in allocations.cpp.
+//
+//     liteviz-bench --out before.json
+//     liteviz-bench --filter upload --max-points 100000000
+
+namespace {
+
+struct Options {
+    std::string out;
+    std::string filter;
+    size_t max_points = 16000000;
+    int frames = 60;
+    int width = 1280;
+    int height = 720;
+};
+
+struct Result {
+    std::string name;
+    std::vector<std::pair<std::string, double>> params;
+    std::vector<std::pair<std::string, double>> metrics;
+};
+
+struct Stats {
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double min = 0.0;
+};
+
+Stats stats(std::vector<double> samples) {
+    Stats s;
+    if (samples.empty())
+        return s;
+    std::sort(samples.begin(), samples.end());
+    s.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    s.p50 = samples[samples.size() / 2];
+    s.p95 = samples[std::min(samples.size() - 1, size_t(samples.size() * 0.95))];
+    s.min = samples.front();
+    return s;
+}
+
+void add_stats(Result& result, const std::string& prefix, const Stats& s) {
+    result.metrics.emplace_back(prefix + "_mean", s.mean);
+    result.metrics.emplace_back(prefix + "_p50", s.p50);
+    result.metrics.emplace_back(prefix + "_p95", s.p95);
+    result.metrics.emplace_back(prefix + "_min", s.min);
+}
+
+void add_counters(Result& result, const GLCounters& c, size_t allocations, int frames) {
+    double n = std::max(frames, 1);
+    result.metrics.emplace_back("draw_calls", c.draw_calls / n);
+    result.metrics.emplace_back("primitives", c.primitives / n);
+    result.metrics.emplace_back("bytes_uploaded", c.bytes_uploaded / n);
+    result.metrics.emplace_back("allocations", allocations / n);
+}
+
+// nearest neighbour resize, keeps the detail encoders see in a real frame
+Image scaled(const Image& img, int width, int height) {
+    Image out(width, height, img.channels);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* row = img.ptr() + size_t(y * img.height / height) * img.width * img.channels;
+        uint8_t* dst = out.ptr() + size_t(y) * width * img.channels;
+        for (int x = 0; x < width; ++x, dst += img.channels)
+            std::memcpy(dst, row + size_t(x * img.width / width) * img.channels, img.channels);
+    }
+    return out;
+}
+
+// keeps the optimizer from dropping the measured work
+volatile const void* sink = nullptr;
+
+template <typename T>
+void keep(const T& value) {
+    sink = &value;
+}
+
+// draws whatever mesh it is given with the matching shader
+class MeshRenderer: public BaseRenderer {
+public:
+    void set(std::shared_ptr<Mesh> mesh, std::shared_ptr<Shader> shader) {
+        this->mesh = std::move(mesh);
+        this->shader = std::move(shader);
+    }
+
+    void render(const Viewport& viewport) override {
+        if (mesh)
+            mesh->draw(shader.get(), viewport);
+    }
+
+private:
+    std::shared_ptr<Mesh> mesh;
+    std::shared_ptr<Shader> shader;
+};
+
+// draws points whose data is rewritten every frame, either through a
+// StreamBuffer or through a fresh glBufferData of each attribute
+class StreamRenderer: public BaseRenderer {
+public:
+    // an empty cloud releases the stream, which needs the context alive
+    void set(std::shared_ptr<Shader> shader, std::vector<vec3f> positions, std::vector<vec4f> colors, bool streamed) {
+        this->shader = std::move(shader);
+        this->positions = std::move(positions);
+        this->colors = std::move(colors);
+        stream.reset();
+        buffer = VertexBuffer();
+        if (streamed && !this->positions.empty()) {
+            // both attributes of a frame in one region, with room for their alignment
+            size_t bytes = (sizeof(vec3f) + sizeof(vec4f)) * this->positions.size() + 128;
+            stream = std::make_unique<StreamBuffer>(bytes);
+        }
+    }
+
+    void render(const Viewport& viewport) override {
+        if (!shader || positions.empty())
+            return;
+        mat4f transform = viewport.getProjectionMatrix() * viewport.getViewMatrix();
+
+        shader->bind(false);
+        shader->set_uniform("ProjMat", transform);
+        shader->set_uniform("PointSize", 1.0f);
+        buffer.bind();
+        if (stream) {
+            shader->stream_attribute(*stream, "Position", positions);
+            shader->stream_attribute(*stream, "Color", colors);
+        } else {
+            shader->set_attribute(buffer, "Position", positions);
+            shader->set_attribute(buffer, "Color", colors);
+        }
+        shader->draw(GL_POINTS, 0, positions.size());
+        buffer.unbind();
+        shader->unbind(false);
+        if (stream)
+            stream->fence();
+    }
+
+    bool persistent() const {
+        return stream && stream->persistent();
+    }
+
+private:
+    std::shared_ptr<Shader> shader;
+    std::vector<vec3f> positions;
+    std::vector<vec4f> colors;
+    std::unique_ptr<StreamBuffer> stream;
+    VertexBuffer buffer;
+};
+
+class Bench {
+public:
+    Bench(const Options& options): options(options), viewer(options.width, options.height) {}
+
+    bool init() {
+        if (!viewer.init())
+            return false;
+        std::string dir = std::string(RESOURCE_DIR) + "/shaders";
+        pointShader = std::make_shared<Shader>((dir + "/draw_point.vert").c_str(), (dir + "/draw_point.frag").c_str());
+        frustumShader = std::make_shared<Shader>((dir + "/draw_frustum.vert").c_str(), (dir + "/draw_point.frag").c_str());
+        gridShader = std::make_shared<Shader>((dir + "/draw_grid.vert").c_str(), (dir + "/draw_grid.frag").c_str());
+        renderer = std::make_shared<MeshRenderer>();
+        viewer.addRenderer(renderer);
+        streamRenderer = std::make_shared<StreamRenderer>();
+        viewer.addRenderer(streamRenderer);
+        return true;
+    }
+
+    void run() {
+        for (size_t points = 1000000; points <= options.max_points; points *= 4)
+            pointCloud(points);
+        if (options.max_points >= 100000000)
+            pointCloud(100000000);
+        for (size_t count : {1000, 10000, 100000})
+            frustums(count);
+        for (size_t points : {100000, 1000000}) {
+            streamed(points, false);
+            streamed(points, true);
+        }
+        grid();
+        capture();
+        viewport();
+        slam();
+    }
+
+    bool write() const {
+        std::ofstream file;
+        if (!options.out.empty()) {
+            file.open(options.out);
+            if (!file) {
+                std::cerr << "Failed to open " << options.out << std::endl;
+                return false;
+            }
+        }
+        std::ostream& out = options.out.empty() ? std::cout : file;
+        auto string = [](const char* text) {
+            std::string s;
+            for (; text && *text; ++text) {
+                if (*text == '"' || *text == '\\')
+                    s += '\\';
+                s += *text;
+            }
+            return s;
+        };
+        auto values = [&](const std::vector<std::pair<std::string, double>>& list) {
+            out << "{";
+            for (size_t i = 0; i < list.size(); ++i) {
+                char number[64];
+                std::snprintf(number, sizeof(number), "%.6g", list[i].second);
+                out << (i ? ", " : "") << "\"" << list[i].first << "\": " << number;
+            }
+            out << "}";
+        };
+
+        out << "{\n  \"benchmark\": \"liteviz-bench\",\n";
+        out << "  \"renderer\": \"" << string(reinterpret_cast<const char*>(glGetString(GL_RENDERER))) << "\",\n";
+        out << "  \"gl_version\": \"" << string(reinterpret_cast<const char*>(glGetString(GL_VERSION))) << "\",\n";
+        out << "  \"width\": " << options.width << ",\n  \"height\": " << options.height << ",\n";
+        out << "  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            out << "    {\"name\": \"" << results[i].name << "\", \"params\": ";
+            values(results[i].params);
+            out << ", \"metrics\": ";
+            values(results[i].metrics);
+            out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+        return bool(out);
+    }
+
+private:
+    // filters match full case names, so cases sharing setup ask with all of theirs
+    bool selected(const std::string& name) const {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    }
+
+    bool selected(std::initializer_list<const char*> names) const {
+        return std::any_of(names.begin(), names.end(), [this](const char* name) { return selected(name); });
+    }
+
+    void report(Result result) {
+        std::cerr << result.name;
+        for (const auto& [key, value] : result.params)
+            std::cerr << " " << key << "=" << value;
+        std::cerr << std::endl;
+        results.push_back(std::move(result));
+    }
+
+    // one frame, GPU included
+    double frame() {
+        Timer timer;
+        viewer.draw();
+        glFinish();
+        return timer.elapsedMs();
+    }
+
+    // `count` frames, the heap allocations they made go to `allocations`
+    std::vector<double> frames(int count, size_t& allocations) {
+        std::vector<double> samples;
+        samples.reserve(count);
+        allocations = heap_allocations();
+        for (int i = 0; i < count; ++i)
+            samples.push_back(frame());
+        allocations = heap_allocations() - allocations;
+        return samples;
+    }
+
+    // first frame uploads the mesh, the following ones draw it as is; the
+    // upload is what the first frame takes on top of a steady one
+    void uploadAndDraw(Result& result, std::shared_ptr<Mesh> mesh, std::shared_ptr<Shader> shader) {
+        renderer->set(mesh, shader);
+        GLCounters start = gl_counters();
+        double first = frame();
+        GLCounters uploaded = gl_counters() - start;
+
+        start = gl_counters();
+        size_t allocations = 0;
+        Stats steady = stats(frames(options.frames, allocations));
+        GLCounters drawn = gl_counters() - start;
+
+        double upload = std::max(first - steady.p50, 1e-3);
+        result.metrics.emplace_back("first_frame_ms", first);
+        result.metrics.emplace_back("upload_ms", upload);
+        result.metrics.emplace_back("upload_bytes", uploaded.bytes_uploaded);
+        result.metrics.emplace_back("upload_mb_per_s", uploaded.bytes_uploaded / 1e3 / upload);
+        add_stats(result, "frame_ms", steady);
+        add_counters(result, drawn, allocations, options.frames);
+    }
+
+    void pointCloud(size_t count) {
+        if (!selected("upload/point_cloud"))
+            return;
+        Result result{"upload/point_cloud", {{"points", double(count)}}, {}};
+
+        Timer timer;
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::vector<vec3f> positions(count);
+        std::vector<vec4f> colors(count);
+        for (size_t i = 0; i < count; ++i) {
+            positions[i] = vec3f(unit(rng), unit(rng), unit(rng));
+            colors[i] = vec4f(positions[i].x() * 0.5f + 0.5f, positions[i].y() * 0.5f + 0.5f, 0.5f, 1.0f);
+        }
+        auto cloud = std::make_shared<PointCloud>();
+        cloud->setup(std::move(positions), std::move(colors));
+        result.metrics.emplace_back("generate_ms", timer.elapsedMs());
+
+        uploadAndDraw(result, cloud, pointShader);
+        renderer->set(nullptr, nullptr);
+        report(std::move(result));
+    }
+
+    void frustums(size_t count) {
+        if (!selected("frame/frustums"))
+            return;
+        Result result{"frame/frustums", {{"frustums", double(count)}}, {}};
+
+        // keyframes along a spiral, like a long trajectory seen from above
+        auto set = std::make_shared<FrustumSet>();
+        std::vector<mat4f> poses(count, mat4f::Identity());
+        for (size_t i = 0; i < count; ++i) {
+            float t = float(i) / count * 20.0f;
+            poses[i].block<3, 3>(0, 0) = Eigen::AngleAxisf(t, vec3f::UnitZ()).toRotationMatrix();
+            poses[i].block<3, 1>(0, 3) = vec3f(std::cos(t) * t * 0.1f, std::sin(t) * t * 0.1f, 0.0f);
+            set->add(poses[i], vec4f(1.0f, 1.0f, 0.6f, 0.4f), COLOR_WHITE, 0.02f);
+        }
+        uploadAndDraw(result, set, frustumShader);
+
+        // pose graph optimization moves 1% of the keyframes every frame
+        std::mt19937 rng(2);
+        std::uniform_int_distribution<size_t> slot(0, count - 1);
+        std::vector<double> samples;
+        GLCounters start = gl_counters();
+        for (int f = 0; f < options.frames; ++f) {
+            for (size_t i = 0; i < std::max<size_t>(count / 100, 1); ++i) {
+                size_t s = slot(rng);
+                poses[s](2, 3) += 0.001f;
+                set->setPose(s, poses[s]);
+            }
+            samples.push_back(frame());
+        }
+        add_stats(result, "update_frame_ms", stats(samples));
+        result.metrics.emplace_back("update_bytes", (gl_counters() - start).bytes_uploaded / double(options.frames));
+
+        renderer->set(nullptr, nullptr);
+        report(std::move(result));
+    }
+
+    // a cloud whose every point changes every frame, e.g. a live depth
+    // sensor: re-specified buffers against the StreamBuffer ring
+    void streamed(size_t count, bool stream) {
+        if (!selected("stream/point_cloud"))
+            return;
+        Result result{"stream/point_cloud", {{"points", double(count)}, {"streamed", stream ? 1.0 : 0.0}}, {}};
+
+        // the same points every frame, what is measured is the upload path
+        std::mt19937 rng(3);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::vector<vec3f> positions(count);
+        std::vector<vec4f> colors(count);
+        for (size_t i = 0; i < count; ++i) {
+            positions[i] = vec3f(unit(rng), unit(rng), unit(rng));
+            colors[i] = vec4f(0.5f, positions[i].y() * 0.5f + 0.5f, positions[i].z() * 0.5f + 0.5f, 1.0f);
+        }
+        streamRenderer->set(pointShader, std::move(positions), std::move(colors), stream);
+        frame();
+
+        GLCounters start = gl_counters();
+        size_t allocations = 0;
+        Stats steady = stats(frames(options.frames, allocations));
+        GLCounters drawn = gl_counters() - start;
+
+        add_stats(result, "frame_ms", steady);
+        result.metrics.emplace_back("upload_bytes_per_frame", drawn.bytes_uploaded / double(options.frames));
+        result.metrics.emplace_back("upload_mb_per_s", drawn.bytes_uploaded / 1e3 / std::max(steady.mean * options.frames, 1e-3));
+        result.metrics.emplace_back("persistent", streamRenderer->persistent() ? 1.0 : 0.0);
+        add_counters(result, drawn, allocations, options.frames);
+
+        streamRenderer->set(nullptr, {}, {}, false);
+        report(std::move(result));
+    }
+
+    void grid() {
+        if (!selected("grid/setup"))
+            return;
+        Result result{"grid/setup", {}, {}};
+
+        auto grid = std::make_shared<Grid>();
+        std::vector<double> samples;
+        for (int i = 0; i < 100; ++i) {
+            Timer timer;
+            grid->setup();
+            samples.push_back(timer.elapsedMs());
+        }
+        add_stats(result, "setup_ms", stats(samples));
+        result.metrics.emplace_back("vertices", grid->getPositions().size());
+
+        uploadAndDraw(result, grid, gridShader);
+        renderer->set(nullptr, nullptr);
+        report(std::move(result));
+    }
+
+    void capture() {
+        if (!selected({"capture/sync", "capture/async", "encode/png_stb", "encode/png_fast", "encode/qoi"}))
+            return;
+
+        // something to look at, encoders behave very differently on flat images
+        std::mt19937 rng(3);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::vector<vec3f> positions(1000000);
+        std::vector<vec4f> colors(positions.size());
+        for (size_t i = 0; i < positions.size(); ++i) {
+            positions[i] = vec3f(unit(rng), unit(rng), unit(rng));
+            colors[i] = vec4f(unit(rng) * 0.5f + 0.5f, 0.3f, unit(rng) * 0.5f + 0.5f, 1.0f);
+        }
+        auto cloud = std::make_shared<PointCloud>();
+        cloud->setup(std::move(positions), std::move(colors));
+        renderer->set(cloud, pointShader);
+        frame();
+
+        if (selected("capture/sync")) {
+            Result result{"capture/sync", {}, {}};
+            std::vector<double> samples;
+            for (int i = 0; i < options.frames; ++i) {
+                viewer.draw();
+                Timer timer;
+                Image img = viewer.getFrameBuffer();
+                samples.push_back(timer.elapsedMs());
+            }
+            add_stats(result, "readback_ms", stats(samples));
+            report(std::move(result));
+        }
+
+        if (selected("capture/async")) {
+            // time spent on the render thread per frame, and frames until the image is back
+            Result result{"capture/async", {}, {}};
+            std::vector<double> request, collect, lag;
+            Image img;
+            for (int f = 0; f < options.frames; ++f) {
+                viewer.draw();
+                Timer timer;
+                viewer.requestFrame(f);
+                request.push_back(timer.elapsedMs());
+                timer.reset();
+                uint64_t tag;
+                while (viewer.collectFrame(img, &tag))
+                    lag.push_back(double(f - int(tag)));
+                collect.push_back(timer.elapsedMs());
+            }
+            glFinish();
+            add_stats(result, "request_ms", stats(request));
+            add_stats(result, "collect_ms", stats(collect));
+            result.metrics.emplace_back("lag_frames_mean", stats(lag).mean);
+            while (viewer.collectFrame(img))
+                ;
+            report(std::move(result));
+        }
+
+        Image img = viewer.render();
+        renderer->set(nullptr, nullptr);
+
+        using Encoder = std::function<bool(const Image&, std::vector<uint8_t>&)>;
+        std::vector<std::pair<std::string, Encoder>> encoders = {
+            {"encode/png_stb", [](const Image& img, std::vector<uint8_t>& out) {
+                out.clear();
+                return stbi_write_png_to_func([](void* context, void* data, int size) {
+                    auto* bytes = static_cast<std::vector<uint8_t>*>(context);
+                    bytes->insert(bytes->end(), static_cast<uint8_t*>(data), static_cast<uint8_t*>(data) + size);
+                }, &out, img.width, img.height, img.channels, img.ptr(), img.width * img.channels) != 0;
+            }},
+            {"encode/png_fast", [](const Image& img, std::vector<uint8_t>& out) {
+                return ImageIO::encode_png_fast(img, out);
+            }},
+            {"encode/qoi", [](const Image& img, std::vector<uint8_t>& out) {
+                return ImageIO::encode_qoi(img, out);
+            }},
+        };
+        // the frame as drawn plus the 1080p and 4K captures users record, scaled from it
+        std::vector<Image> images = {img};
+        for (auto [width, height] : {std::make_pair(1920, 1080), std::make_pair(3840, 2160)}) {
+            if (width != img.width || height != img.height)
+                images.push_back(scaled(img, width, height));
+        }
+        for (const auto& [name, encode] : encoders) {
+            if (!selected(name))
+                continue;
+            for (const Image& image : images) {
+                Result result{name, {{"width", double(image.width)}, {"height", double(image.height)}}, {}};
+                std::vector<uint8_t> bytes;
+                std::vector<double> samples;
+                for (int i = 0; i < 5; ++i) {
+                    Timer timer;
+                    encode(image, bytes);
+                    samples.push_back(timer.elapsedMs());
+                }
+                add_stats(result, "encode_ms", stats(samples));
+                result.metrics.emplace_back("bytes", bytes.size());
+                report(std::move(result));
+            }
+        }
+    }
+
+    void viewport() {
+        if (!selected({"viewport/matrices", "viewport/rotate", "viewport/cull"}))
+            return;
+        const size_t iterations = 1000000;
+        Viewport view(options.width, options.height);
+        view.frameBufferSize = view.windowSize;
+
+        if (selected("viewport/matrices")) {
+            Result result{"viewport/matrices", {{"iterations", double(iterations)}}, {}};
+            Timer timer;
+            mat4f sum = mat4f::Zero();
+            for (size_t i = 0; i < iterations; ++i) {
+                view.setFoV(50.0f + (i & 15));
+                sum += view.getProjectionMatrix() * view.getViewMatrix();
+            }
+            keep(sum);
+            result.metrics.emplace_back("ns_per_op", timer.elapsedMs() * 1e6 / iterations);
+            report(std::move(result));
+        }
+
+        if (selected("viewport/rotate")) {
+            Result result{"viewport/rotate", {{"iterations", double(iterations)}}, {}};
+            Timer timer;
+            for (size_t i = 0; i < iterations; ++i)
+                view.camera.rotate(vec2f(float(i & 255), float((i >> 8) & 255)));
+            keep(view.camera.getTransformation());
+            result.metrics.emplace_back("ns_per_op", timer.elapsedMs() * 1e6 / iterations);
+            report(std::move(result));
+        }
+
+        if (selected("viewport/cull")) {
+            // octree style culling: frustum planes once, then one box test per node
+            Result result{"viewport/cull", {{"boxes", double(iterations)}}, {}};
+            std::mt19937 rng(4);
+            std::uniform_real_distribution<float> unit(-10.0f, 10.0f);
+            std::vector<vec3f> centers(iterations);
+            for (auto& center : centers)
+                center = vec3f(unit(rng), unit(rng), unit(rng));
+            Timer timer;
+            ViewFrustum frustum(view);
+            size_t visible = 0;
+            for (const auto& center : centers)
+                visible += frustum.intersects(center, vec3f(0.5f, 0.5f, 0.5f));
+            keep(visible);
+            result.metrics.emplace_back("ns_per_op", timer.elapsedMs() * 1e6 / iterations);
+            result.metrics.emplace_back("visible", visible);
+            report(std::move(result));
+        }
+    }
+
+    // a SLAM session at one tracking frame per drawn frame, through post() like
+    // a real backend; last, since the scene stays registered with the viewer
+    void slam() {
+        if (!selected("slam/session"))
+            return;
+        const size_t steps = size_t(options.frames) * 10;
+        Result result{"slam/session", {{"steps", double(steps)}, {"seed", 1.0}}, {}};
+
+        auto scene = std::make_shared<SlamScene>();
+        scene->loadShaders(std::string(RESOURCE_DIR) + "/shaders");
+        viewer.addRenderer(scene);
+        SlamDriver driver(scene, [this](UpdateQueue::Command command) { viewer.post(std::move(command)); });
+
+        std::vector<double> samples;
+        samples.reserve(steps);
+        GLCounters start = gl_counters();
+        size_t allocations = heap_allocations();
+        for (size_t i = 0; i < steps; ++i) {
+            driver.step();
+            samples.push_back(frame());
+        }
+        allocations = heap_allocations() - allocations;
+        GLCounters work = gl_counters() - start;
+
+        add_stats(result, "frame_ms", stats(samples));
+        std::vector<double> last(samples.end() - std::min<size_t>(samples.size(), 60), samples.end());
+        result.metrics.emplace_back("frame_ms_last60", stats(last).mean);
+        FrameProfiler::Stats latency = driver.getLatency();
+        result.metrics.emplace_back("latency_ms_p50", latency.p50);
+        result.metrics.emplace_back("latency_ms_p95", latency.p95);
+        result.metrics.emplace_back("latency_ms_max", latency.max);
+        add_counters(result, work, allocations, int(steps));
+        report(std::move(result));
+    }
+
+    Options options;
+    HeadlessViewer viewer;
+    std::shared_ptr<MeshRenderer> renderer;
+    std::shared_ptr<StreamRenderer> streamRenderer;
+    std::shared_ptr<Shader> pointShader;
+    std::shared_ptr<Shader> frustumShader;
+    std::shared_ptr<Shader> gridShader;
+    std::vector<Result> results;
+};
+
+void usage() {
+    std::cerr << "usage: liteviz-bench [--out file.json] [--filter substring] [--max-points n]\n"
+                 "                     [--frames n] [--size WxH]" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--out") {
+            options.out = value;
+        } else if (arg == "--filter") {
+            options.filter = value;
+        } else if (arg == "--max-points") {
+            options.max_points = std::stoull(value);
+        } else if (arg == "--frames") {
+            options.frames = std::max(std::stoi(value), 1);
+        } else if (arg == "--size") {
+            if (std::sscanf(value.c_str(), "%dx%d", &options.width, &options.height) != 2) {
+                usage();
+                return 1;
+            }
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    Bench bench(options);
+    if (!bench.init()) {
+        std::cerr << "Failed to create the offscreen context" << std::endl;
+        return 1;
+    }
+    bench.run();
+    return bench.write() ? 0 : 1;
+}
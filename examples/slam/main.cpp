@@ -0,0 +1,102 @@
+#include <liteviz/core/detail.h>
+#include <liteviz/core/workload.h>
+
+using namespace liteviz;
+
+// Drives the viewer with a synthetic SLAM session (SlamWorkload) to reproduce
+// production load locally. Turn on the profiler in the configuration panel for
+// frame times; the update latency is shown next to the camera image.
+//
+//     slam-test --seed 7 --rate 60 --points 5000
+
+class WorkloadPanel : public BaseRenderer {
+public:
+    WorkloadPanel(std::shared_ptr<SlamScene> scene, const SlamDriver* driver): _scene(scene), _driver(driver) {}
+
+    void render(const Viewport& viewport) override {
+
+        ImGui::Begin("SLAM workload");
+
+        FrameProfiler::Stats latency = _driver->getLatency();
+        ImGui::Text("%zu steps posted", _driver->getPosted());
+        ImGui::Text("Update latency p50 %.2f ms, p95 %.2f ms, max %.2f ms", latency.p50, latency.p95, latency.max);
+
+        if (const ImageTexture* image = _scene->getImage()) {
+            float width = ImGui::GetContentRegionAvail().x;
+            float height = width * image->textureSize.y() / std::max(image->textureSize.x(), 1);
+            ImGui::Image((ImTextureID)(intptr_t)image->getTextureID(), ImVec2(width, height));
+        }
+
+        ImGui::End();
+    }
+
+private:
+    std::shared_ptr<SlamScene> _scene;
+    const SlamDriver* _driver;
+};
+
+class LiteViz: public ViewerDetail {
+
+    SlamWorkload::Config workloadConfig;
+    std::unique_ptr<SlamDriver> driver;
+
+public:
+    LiteViz(std::string title, int width, int height, const SlamWorkload::Config& config):
+
+        ViewerDetail(title, width, height), workloadConfig(config) {
+
+        std::cout << "SLAM workload viewer initialized." << std::endl;
+    }
+
+    ~LiteViz() {
+        // no more updates once the render loop is gone
+        driver.reset();
+    }
+
+    bool initResources() override {
+
+        std::shared_ptr<SlamScene> scene = std::make_shared<SlamScene>();
+        scene->loadShaders(std::string(RESOURCE_DIR) + "/shaders");
+        _registeredRenderers.push_back(scene);
+
+        driver = std::make_unique<SlamDriver>(scene, [this](UpdateQueue::Command command) {
+            post(std::move(command));
+        }, workloadConfig);
+        _registeredGUIRenderers.push_back(std::make_shared<WorkloadPanel>(scene, driver.get()));
+
+        return driver->start();
+    }
+};
+
+
+int main(int argc, char** argv) {
+
+    SlamWorkload::Config config;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+        if (arg == "--seed") {
+            config.seed = std::stoul(value);
+        } else if (arg == "--rate") {
+            config.rate = std::stod(value);
+            if (!(config.rate > 0.0) || !std::isfinite(config.rate)) {
+                std::cerr << "--rate must be a positive number of steps per second" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--points") {
+            config.points_per_keyframe = std::stoul(value);
+        } else if (arg == "--keyframe-interval") {
+            config.keyframe_interval = std::stoi(value);
+        } else if (arg == "--optimize-interval") {
+            config.optimize_interval = std::stoi(value);
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    std::shared_ptr<LiteViz> viewer = std::make_shared<LiteViz>("LiteViz SLAM Workload", 1280, 720, config);
+    viewer->draw();
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+#ifndef __LITEVIZ_ANCHORED_H__
+#define __LITEVIZ_ANCHORED_H__
+
+#include <liteviz/core/common.h>
+#include <liteviz/core/shader.h>
+#include <liteviz/core/viewport.h>
+#include <liteviz/core/mesh.h>
+
+namespace liteviz {
+
+// Geometry stored relative to keyframes, drawn with shaders/draw_anchored.vert.
+// Every vertex carries the index of its anchor keyframe and is placed by that
+// keyframe's pose in a PoseBuffer at draw time, so when the backend moves
+// keyframes only the pose buffer changes and the vertex buffers stay as they
+// are. Vertices are appended in the anchor's local frame.
+class AnchoredMesh: public Mesh{
+public:
+    // the buffer has to outlive the mesh, several meshes may share one
+    void setPoseBuffer(PoseBuffer* poses){
+        pose_buffer = poses;
+    }
+
+    void clean() override {
+        Mesh::clean();
+        anchors.clear();
+    }
+
+    const std::vector<GLuint>& getAnchors() const {return anchors;}
+
+protected:
+    void appendAnchored(const std::vector<vec3f>& local, const std::vector<vec4f>& color, const std::vector<GLuint>& anchor){
+        appendVertices(local, color);
+        if(anchor.size() != local.size())
+            std::cerr << "Got " << anchor.size() << " anchors for " << local.size() << " appended vertices, padding with keyframe 0" << std::endl;
+        anchors.insert(anchors.end(), anchor.begin(), anchor.begin() + std::min(local.size(), anchor.size()));
+        anchors.resize(positions.size(), 0);
+    }
+
+    void appendAnchored(const std::vector<vec3f>& local, const vec4f& color, GLuint anchor){
+        appendVertices(local, color);
+        anchors.resize(positions.size(), anchor);
+    }
+
+    // Mesh::upload plus the anchor indices, expects `buffer` to be bound
+    void upload(Shader* shader){
+        if(buffer.outdated(version, shader->programID())){
+            shader->set_attribute(buffer, "Color", getColors());
+            shader->set_attribute(buffer, "Position", getPositions());
+            shader->set_integer_attribute(buffer, "Anchor", anchors);
+        }else if(buffer.vertices() < positions.size()){
+            shader->append_attribute(buffer, "Color", getColors(), buffer.vertices());
+            shader->append_attribute(buffer, "Position", getPositions(), buffer.vertices());
+            shader->append_integer_attribute(buffer, "Anchor", anchors, buffer.vertices());
+        }else{
+            return;
+        }
+        buffer.validate(version, shader->programID(), positions.size());
+    }
+
+    void drawAnchored(Shader* shader, const Viewport& viewport, GLenum mode, float point_size){
+        // the shader indexes the pose buffer, which holds nothing before the first keyframe
+        if(!pose_buffer || pose_buffer->size() == 0 || positions.empty())
+            return;
+
+        mat4f transform = viewport.getProjectionMatrix() * viewport.getViewMatrix();
+
+        shader->bind(false);
+        shader->set_uniform("ProjMat", transform);
+        shader->set_uniform("Alpha", 1.0f);
+        shader->set_uniform("PointSize", point_size);
+        shader->set_uniform("PoseCount", static_cast<int>(pose_buffer->size()));
+        pose_buffer->bind();
+        buffer.bind();
+        upload(shader);
+        shader->draw(mode, 0, positions.size());
+        buffer.unbind();
+        shader->unbind(false);
+    }
+
+    std::vector<GLuint> anchors;
+    PoseBuffer* pose_buffer = nullptr;
+};
+
+// map points in the frame of their reference keyframe
+class AnchoredPointCloud: public AnchoredMesh{
+public:
+    void setup(const std::vector<vec3f>& local, const std::vector<vec4f>& color, const std::vector<GLuint>& anchor){
+        clean();
+        appendAnchored(local, color, anchor);
+    }
+
+    void append(const std::vector<vec3f>& local, const std::vector<vec4f>& color, const std::vector<GLuint>& anchor){
+        appendAnchored(local, color, anchor);
+    }
+
+    // all points observed from one keyframe
+    void append(const std::vector<vec3f>& local, const std::vector<vec4f>& color, GLuint anchor){
+        appendVertices(local, color);
+        anchors.resize(positions.size(), anchor);
+    }
+
+    void append(const std::vector<vec3f>& local, const vec4f color, GLuint anchor){
+        appendAnchored(local, color, anchor);
+    }
+
+    void setPointSize(const int size){
+        point_size = size;
+    }
+
+    std::shared_ptr<Mesh> clone() const override {
+        return std::make_shared<AnchoredPointCloud>(*this);
+    }
+
+    void draw(Shader* shader, const Viewport& viewport) override {
+        drawAnchored(shader, viewport, GL_POINTS, static_cast<float>(point_size));
+    }
+
+protected:
+    int point_size = 1;
+};
+
+// polyline through anchored vertices, e.g. a trajectory with one vertex at
+// the origin of every keyframe
+class AnchoredLine: public AnchoredMesh{
+public:
+    void setup(const std::vector<vec3f>& local, const std::vector<vec4f>& color, const std::vector<GLuint>& anchor){
+        clean();
+        appendAnchored(local, color, anchor);
+    }
+
+    void append(const std::vector<vec3f>& local, const std::vector<vec4f>& color, const std::vector<GLuint>& anchor){
+        appendAnchored(local, color, anchor);
+    }
+
+    // extend the trajectory to the origin of keyframe `anchor`
+    void appendKeyframe(GLuint anchor, const vec4f color = COLOR_WHITE){
+        appendAnchored(std::vector<vec3f>{vec3f::Zero()}, color, anchor);
+    }
+
+    std::shared_ptr<Mesh> clone() const override {
+        return std::make_shared<AnchoredLine>(*this);
+    }
+
+    void draw(Shader* shader, const Viewport& viewport) override {
+        drawAnchored(shader, viewport, GL_LINE_STRIP, 1.0f);
+    }
+};
+
+} // namespace liteviz
+
+#endif // __LITEVIZ_ANCHORED_H__
@@ -13,6 +13,7 @@ struct BaseConfig{
     float targetFrameRate = -1.0f;
     float fov = 60.0f;
     bool vsync = true;
+    bool renderOnDemand = false;    // only redraw after input, updates or requestRedraw()
     bool transparentConfigBG = true;
     float x_size = 300.0f;
     float y_size = 20.0f;
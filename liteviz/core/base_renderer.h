@@ -12,6 +12,10 @@ class BaseRenderer {
 public:
     virtual ~BaseRenderer() = default;
     virtual void render(const Viewport& viewport) = 0;
+
+    // true while the renderer needs frames although nothing else changed,
+    // e.g. an animation; polled by the viewer when rendering on demand
+    virtual bool isDirty() const { return false; }
 };
 
 } // namespace liteviz
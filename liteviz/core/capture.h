@@ -0,0 +1,140 @@
+#ifndef __LITEVIZ_CAPTURE_H__
+#define __LITEVIZ_CAPTURE_H__
+
+#include <liteviz/core/common.h>
+#include <liteviz/core/shader.h>
+#include <liteviz/core/image.h>
+
+namespace liteviz {
+
+// Asynchronous framebuffer readback through a ring of pixel pack buffers.
+// request() only queues a glReadPixels into the next buffer and a fence, the
+// GPU copies while the following frames are drawn; collect() maps a buffer
+// once its fence has passed, which with the default three slots is one or
+// two frames later, and never waits. Rows are flipped to top first while
+// copying out of the mapping.
+class FrameCapture {
+public:
+    explicit FrameCapture(int slots = 3): slots(slots) {}
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    ~FrameCapture() {
+        release();
+    }
+
+    // drop all buffers and pending readbacks, needs the context they were made in
+    void release() {
+        for (auto& slot : slots) {
+            if (slot.fence)
+                glDeleteSync(slot.fence);
+            if (slot.buffer != 0)
+                glDeleteBuffers(1, &slot.buffer);
+            slot = Slot();
+        }
+        first = 0;
+        count = 0;
+    }
+
+    // read `width` x `height` RGBA from the current read framebuffer, false
+    // if every slot still holds a readback that was not collected
+    bool request(int width, int height, uint64_t tag = 0) {
+        if (count == slots.size())
+            return false;
+
+        LITEVIZ_TRACE_SCOPE("readback request", "gl");
+        Slot& slot = slots[(first + count) % slots.size()];
+        size_t bytes = size_t(width) * height * 4;
+        if (slot.buffer == 0)
+            glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        if (slot.capacity < bytes) {
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+            slot.capacity = bytes;
+        }
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.width = width;
+        slot.height = height;
+        slot.tag = tag;
+        ++count;
+        return true;
+    }
+
+    // copy the oldest readback into `out` if the GPU is done with it,
+    // reusing the storage of `out`; readbacks come out in request order
+    bool collect(Image& out, uint64_t* tag = nullptr) {
+        return take(out, tag, 0);
+    }
+
+    // same, waiting for the GPU if needed; false only if nothing was requested
+    bool wait(Image& out, uint64_t* tag = nullptr) {
+        return take(out, tag, GL_TIMEOUT_IGNORED);
+    }
+
+    // readbacks requested but not collected yet
+    size_t pending() const {
+        return count;
+    }
+
+private:
+    struct Slot {
+        GLuint buffer = 0;
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+        int width = 0;
+        int height = 0;
+        uint64_t tag = 0;
+    };
+
+    bool take(Image& out, uint64_t* tag, GLuint64 timeout) {
+        if (count == 0)
+            return false;
+
+        Slot& slot = slots[first];
+        GLenum status = glClientWaitSync(slot.fence, timeout ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, timeout);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            // make sure the fence reaches the GPU, later polls would never see it pass otherwise
+            glFlush();
+            return false;
+        }
+        LITEVIZ_TRACE_SCOPE("readback", "gl");
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+
+        out.width = slot.width;
+        out.height = slot.height;
+        out.channels = 4;
+        size_t row_bytes = size_t(slot.width) * 4;
+        out.data.resize(row_bytes * slot.height);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        const uint8_t* pixels = static_cast<const uint8_t*>(
+            glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, row_bytes * slot.height, GL_MAP_READ_BIT));
+        if (pixels) {
+            for (int y = 0; y < slot.height; ++y) {
+                std::memcpy(out.ptr() + y * row_bytes, pixels + (slot.height - 1 - y) * row_bytes, row_bytes);
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        if (tag)
+            *tag = slot.tag;
+        first = (first + 1) % slots.size();
+        --count;
+        return pixels != nullptr;
+    }
+
+    std::vector<Slot> slots;
+    size_t first = 0;       // oldest pending readback
+    size_t count = 0;
+};
+
+} // namespace liteviz
+
+#endif // __LITEVIZ_CAPTURE_H__
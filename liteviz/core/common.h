@@ -18,7 +18,11 @@
 #include <cmath>
 #include <map>
 #include <array>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
 #include <unordered_map>
+#include <deque>
 
 #include <Eigen/Eigen>
 #include <Eigen/Core>
@@ -55,6 +59,9 @@ using mat4f = Eigen::Matrix<float, 4, 4>;
 using mat5f = Eigen::Matrix<float, 5, 5>;
 using mat6f = Eigen::Matrix<float, 6, 6>;
 
+using vec4ub = Eigen::Matrix<uint8_t, 4, 1>;
+using vec3us = Eigen::Matrix<uint16_t, 3, 1>;
+
 using vec2i = Eigen::Vector2i;
 using vec3i = Eigen::Vector3i;
 using vec4i = Eigen::Vector4i;
@@ -1,6 +1,29 @@
 #include <liteviz/core/detail.h>
 #include <liteviz/core/image.h>
 
+#include <typeinfo>
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+namespace {
+
+std::string type_name(const liteviz::BaseRenderer& renderer) {
+    const char* mangled = typeid(renderer).name();
+#ifdef __GNUG__
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+    if (status == 0 && demangled) {
+        std::string name(demangled);
+        std::free(demangled);
+        return name;
+    }
+#endif
+    return mangled;
+}
+
+} // namespace
+
 liteviz::ViewerDetail* liteviz::ViewerDetail::_detail = nullptr;
 
 liteviz::ViewerDetail::ViewerDetail(std::string title, int width, int height):
@@ -54,6 +77,13 @@ bool liteviz::ViewerDetail::init(){
     glfwSetKeyCallback(window, keyCallback);
     glfwSetDropCallback(window, dropCallback);
 
+    // events without a handler of their own still change what is on screen
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow*){ _detail->requestRedraw(); });
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow*, int, int){ _detail->requestRedraw(); });
+    glfwSetWindowFocusCallback(window, [](GLFWwindow*, int){ _detail->requestRedraw(); });
+    glfwSetCursorEnterCallback(window, [](GLFWwindow*, int){ _detail->requestRedraw(); });
+    glfwSetCharCallback(window, [](GLFWwindow*, unsigned int){ _detail->requestRedraw(); });
+
     glEnable(GL_LINE_SMOOTH);
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LEQUAL);
@@ -62,6 +92,9 @@ bool liteviz::ViewerDetail::init(){
     glBlendEquation(GL_FUNC_ADD);
     glEnable(GL_PROGRAM_POINT_SIZE);
 
+    // Shaders for published snapshots
+    _sceneRenderer.loadShaders(std::string(RESOURCE_DIR) + "/shaders");
+
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -105,6 +138,7 @@ void liteviz::ViewerDetail::updateWindowSize(){
 
 
 void liteviz::ViewerDetail::mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+    _detail->requestRedraw();
     if(_detail->any_window_active)
         return;
 
@@ -116,6 +150,7 @@ void liteviz::ViewerDetail::mouseButtonCallback(GLFWwindow* window, int button,
 }
 
 void liteviz::ViewerDetail::cursorPosCallback(GLFWwindow* window, double x, double y) {
+    _detail->requestRedraw();
     if(_detail->any_window_active)
         return;
 
@@ -127,6 +162,7 @@ void liteviz::ViewerDetail::cursorPosCallback(GLFWwindow* window, double x, doub
 }
 
 void liteviz::ViewerDetail::scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
+    _detail->requestRedraw();
     if (_detail->any_window_active)
         return;
 
@@ -143,6 +179,7 @@ void liteviz::ViewerDetail::scrollCallback(GLFWwindow* window, double xoffset, d
 }
 
 void liteviz::ViewerDetail::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods){
+    _detail->requestRedraw();
     if(_detail->any_window_active)
         return;
 
@@ -151,6 +188,7 @@ void liteviz::ViewerDetail::keyCallback(GLFWwindow* window, int key, int scancod
 }
 
 void liteviz::ViewerDetail::dropCallback(GLFWwindow* window, int count, const char** paths) {
+    _detail->requestRedraw();
     if(_detail->any_window_active)
         return;
 
@@ -190,6 +228,15 @@ liteviz::Image liteviz::ViewerDetail::getFrameBuffer() {
     return img;
 }
 
+void liteviz::ViewerDetail::collectSnapshots() {
+    Image img;
+    while (!_snapshotPaths.empty() && _capture.collect(img)) {
+        _snapshotWriter.write(std::move(_snapshotPaths.front()), std::move(img));
+        _snapshotPaths.pop_front();
+        img = Image();
+    }
+}
+
 void liteviz::ViewerDetail::controlFrameRate(liteviz::BaseConfig* config) {
 
     if(!config->vsync || config->targetFrameRate <= 0)
@@ -224,8 +271,25 @@ void liteviz::ViewerDetail::configuration(liteviz::BaseConfig* config) {
     ImGui::Separator();
 
     if (ImGui::Button("Save snapshot", ImVec2(-FLT_MIN, config->y_size * 2.0f))) {
-        Image img = getFrameBuffer();
-        ImageIO::save_png("snapshot-color-" + getTimestamp() + ".png", img);
+        int w = _viewport.frameBufferSize.x();
+        int h = _viewport.frameBufferSize.y();
+        if (_capture.request(w, h))
+            _snapshotPaths.push_back("snapshot-color-" + getTimestamp() + ".png");
+        else
+            std::cerr << "Snapshot skipped, " << _capture.pending() << " readbacks still in flight" << std::endl;
+    }
+
+    if (!_recorder.isRecording()) {
+        ImGui::Combo("##record_format", &recordFormat, "PNG\0Raw RGBA\0Y4M\0QOI\0");
+        ImGui::SameLine();
+        if (ImGui::Button("Record", ImVec2(-FLT_MIN, 0.0f))) {
+            _recorder.start("recording-" + getTimestamp(), FrameRecorder::Format(recordFormat),
+                            config->targetFrameRate > 0 ? int(config->targetFrameRate) : 30);
+        }
+    } else {
+        if (ImGui::Button("Stop recording", ImVec2(-FLT_MIN, 0.0f)))
+            _recorder.stop();
+        ImGui::Text("Recorded %zu frames, dropped %zu", _recorder.getRecorded(), _recorder.getDropped());
     }
 
     ImGui::SliderFloat("##fov_slider", &config->fov, 10.0f, 120.0f, "FoV=%.1f");
@@ -235,6 +299,17 @@ void liteviz::ViewerDetail::configuration(liteviz::BaseConfig* config) {
     }
 
     ImGui::Checkbox("Vertical Synch.", &config->vsync);
+    ImGui::Checkbox("Render on demand", &config->renderOnDemand);
+    ImGui::Checkbox("Profiler", &showProfiler);
+
+    if (ImGui::Checkbox("Trace", &tracing))
+        trace_recorder().setEnabled(tracing);
+    if (tracing) {
+        ImGui::SameLine();
+        if (ImGui::Button("Dump trace", ImVec2(-FLT_MIN, 0.0f)))
+            dumpTrace();
+        ImGui::SliderFloat("##trace_hitch", &traceHitchMs, 0.0f, 500.0f, "Dump on hitch > %.0f ms");
+    }
     ImGui::Checkbox("Transparent Config BG", &config->transparentConfigBG);
 
     if (ImGui::ColorEdit4("Background", config->bgColor.data())) {
@@ -248,9 +323,178 @@ void liteviz::ViewerDetail::configuration(liteviz::BaseConfig* config) {
     float frameRate = ImGui::GetIO().Framerate;
     ImGui::Text("Average %.3f ms/frame (%.1f FPS)", frameTime, frameRate);
 
+    workCounters();
+
     ImGui::End();
 }
 
+void liteviz::ViewerDetail::workCounters() {
+
+    ImGui::Text("%zu draws, %zu primitives, %.1f KB uploaded", frameCounters.draw_calls,
+                frameCounters.primitives, frameCounters.bytes_uploaded / 1024.0);
+    if (!ImGui::CollapsingHeader("GL work per section"))
+        return;
+
+    const auto& sections = _profiler.getSections();
+    if (ImGui::BeginTable("##gl_work", 7, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+        ImGui::TableSetupColumn("Section", ImGuiTableColumnFlags_WidthStretch);
+        for (const char* column : {"Draws", "Prims", "KB up", "Progs", "VAOs", "Unifs"})
+            ImGui::TableSetupColumn(column);
+        ImGui::TableHeadersRow();
+        for (size_t i = 0; i < sectionCounters.size() && i < sections.size(); ++i) {
+            const GLCounters& c = sectionCounters[i];
+            if (c.draw_calls == 0 && c.bytes_uploaded == 0 && c.program_binds == 0)
+                continue;
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%*s%s", sections[i].depth * 2, "", sections[i].name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu", c.draw_calls);
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu", c.primitives);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", c.bytes_uploaded / 1024.0);
+            for (size_t value : {c.program_binds, c.vao_binds, c.uniform_updates}) {
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", value);
+            }
+        }
+        ImGui::EndTable();
+    }
+}
+
+void liteviz::ViewerDetail::profilerOverlay() {
+
+    if (!showProfiler)
+        return;
+
+    ImGui::SetNextWindowSize(ImVec2(560.0f, 0.0f), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Profiler", &showProfiler);
+
+    if (_profiler.hasGpuTimes())
+        ImGui::Text("GPU times are %zu frames old, %zu frames skipped", _profiler.getLatency(), _profiler.getSkippedFrames());
+    else
+        ImGui::Text("No GPU timer queries, CPU times only");
+
+    const auto& sections = _profiler.getSections();
+    if (ImGui::BeginTable("##profile", 7, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+        ImGui::TableSetupColumn("Section (ms)", ImGuiTableColumnFlags_WidthStretch);
+        for (const char* column : {"CPU p50", "p95", "p99", "GPU p50", "p95", "p99"})
+            ImGui::TableSetupColumn(column);
+        ImGui::TableHeadersRow();
+        for (const auto& section : sections) {
+            FrameProfiler::Stats cpu = section.cpu.stats();
+            FrameProfiler::Stats gpu = section.gpu.stats();
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%*s%s", section.depth * 2, "", section.name.c_str());
+            for (float value : {cpu.p50, cpu.p95, cpu.p99, gpu.p50, gpu.p95, gpu.p99}) {
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", value);
+            }
+        }
+        ImGui::EndTable();
+    }
+
+    for (const auto& section : sections) {
+        if (!ImGui::TreeNode(section.name.c_str()))
+            continue;
+        for (const auto* history : {&section.cpu, &section.gpu}) {
+            if (history->samples.empty())
+                continue;
+            FrameProfiler::Stats stats = history->stats();
+            char overlay[64];
+            std::snprintf(overlay, sizeof(overlay), "%s %.3f ms, max %.3f",
+                          history == &section.cpu ? "CPU" : "GPU", stats.last, stats.max);
+            ImGui::PushID(history);
+            ImGui::PlotHistogram("##history", history->samples.data(), int(history->samples.size()),
+                                 int(history->next), overlay, 0.0f, stats.max * 1.1f, ImVec2(-FLT_MIN, 50.0f));
+            ImGui::PopID();
+        }
+        ImGui::TreePop();
+    }
+
+    ImGui::End();
+}
+
+void liteviz::ViewerDetail::dumpTrace(const std::string& prefix) {
+    std::string path = prefix + getTimestamp() + ".json";
+    if (trace_recorder().dump(path))
+        std::cout << "Trace written to " << path << std::endl;
+    lastTraceDump.reset();
+}
+
+void liteviz::ViewerDetail::post(UpdateQueue::Command command) {
+    _updates.push(std::move(command));
+    requestRedraw();
+}
+
+std::shared_ptr<liteviz::SceneSnapshot> liteviz::ViewerDetail::createScene() const {
+    return _scenes.create();
+}
+
+void liteviz::ViewerDetail::publish(std::shared_ptr<const SceneSnapshot> snapshot) {
+    _scenes.publish(std::move(snapshot));
+    requestRedraw();
+}
+
+void liteviz::ViewerDetail::requestRedraw() {
+    redrawRequested.store(true, std::memory_order_release);
+    // wakes glfwWaitEventsTimeout, safe from any thread once the window exists
+    if (window)
+        glfwPostEmptyEvent();
+}
+
+const liteviz::GLCounters& liteviz::ViewerDetail::getFrameCounters() const {
+    return frameCounters;
+}
+
+liteviz::GLCounters liteviz::ViewerDetail::getRendererCounters(const BaseRenderer* renderer) {
+    size_t section = rendererSection(renderer);
+    return section < sectionCounters.size() ? sectionCounters[section] : GLCounters();
+}
+
+liteviz::ViewerDetail::SectionScope::SectionScope(ViewerDetail& viewer, size_t section):
+    viewer(viewer), section(section), start(gl_counters()), scope(viewer._profiler, section) {}
+
+liteviz::ViewerDetail::SectionScope::~SectionScope() {
+    if (viewer.countingSections.size() <= section)
+        viewer.countingSections.resize(section + 1);
+    viewer.countingSections[section] += gl_counters() - start;
+}
+
+size_t liteviz::ViewerDetail::rendererSection(const BaseRenderer* renderer) {
+    auto it = rendererSections.find(renderer);
+    if (it != rendererSections.end())
+        return it->second;
+    std::string name = type_name(*renderer) + " #" + std::to_string(rendererSections.size());
+    size_t section = _profiler.getSection(name);
+    rendererSections.emplace(renderer, section);
+    return section;
+}
+
+bool liteviz::ViewerDetail::needsRedraw() {
+    if (!_config->renderOnDemand)
+        return true;
+    if (redrawRequested.exchange(false, std::memory_order_acq_rel))
+        redrawFrames = settleFrames;
+    if (redrawFrames > 0) {
+        --redrawFrames;
+        return true;
+    }
+    if (_updates.size() > 0 || _capture.pending() > 0 || _recorder.isRecording())
+        return true;
+    for (const auto& renderer : _registeredRenderers) {
+        if (renderer->isDirty())
+            return true;
+    }
+    for (const auto& renderer : _registeredGUIRenderers) {
+        if (renderer->isDirty())
+            return true;
+    }
+    return false;
+}
+
 void liteviz::ViewerDetail::draw() {
 
     if (!this->init()) {
@@ -263,46 +507,114 @@ void liteviz::ViewerDetail::draw() {
         return;
     }
 
+    trace_recorder().setThreadName("render");
+
     while (!glfwWindowShouldClose(window)) {
 
+        if (!needsRedraw()) {
+            glfwWaitEventsTimeout(idleTimeout);
+            continue;
+        }
+
+        Timer frameTimer;
+        GLCounters frameStart = gl_counters();
+
+        _profiler.setEnabled(showProfiler);
+        _profiler.beginFrame();
+
         glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         updateWindowSize();
 
+        {
+            SectionScope scope(*this, _profiler.getSection("updates"));
+            _updates.drain(updateBudget);
+        }
+
         renderAll(_viewport);
 
-        glfwSwapBuffers(window);
+        {
+            SectionScope scope(*this, _profiler.getSection("swap"));
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
+
+        _profiler.endFrame();
+
+        frameCounters = gl_counters() - frameStart;
+        sectionCounters.swap(countingSections);
+        countingSections.assign(sectionCounters.size(), GLCounters());
+
+        if (tracing && traceHitchMs > 0.0f && frameTimer.elapsedMs() - pacingMs > traceHitchMs
+            && lastTraceDump.elapsed() > traceHitchInterval) {
+            dumpTrace("trace-hitch-");
+        }
     }
+
+    _recorder.stop();
+    _profiler.release();
+    // meshes of the last snapshot go while the context is still current
+    _sceneRenderer.setScene(nullptr);
+    _scenes.publish(nullptr);
+    _scenes.acquire();
     
 }
 
 
 void liteviz::ViewerDetail::renderAll(liteviz::Viewport& _viewport) {
 
+    {
+        SectionScope scope(*this, _profiler.getSection("scene"));
+        _sceneRenderer.setScene(_scenes.acquire());
+        _sceneRenderer.render(_viewport);
+    }
+
     for (const auto& renderer : _registeredRenderers) {
+        SectionScope scope(*this, rendererSection(renderer.get()));
         renderer->render(_viewport);
     }
 
-    ImGui_ImplOpenGL3_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
-    ImGui::NewFrame();
-    
-    _detail->any_window_active = ImGui::IsAnyItemActive();
+    {
+        SectionScope scope(*this, _profiler.getSection("recording"));
+        _recorder.capture(_viewport.frameBufferSize.x(), _viewport.frameBufferSize.y());
+    }
 
-    configuration(_config.get()); 
+    {
+        SectionScope scope(*this, _profiler.getSection("imgui"));
 
-    for (const auto& renderer : _registeredGUIRenderers) {
-        renderer->render(_viewport);
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+
+        _detail->any_window_active = ImGui::IsAnyItemActive();
+
+        configuration(_config.get());
+
+        for (const auto& renderer : _registeredGUIRenderers) {
+            SectionScope scope(*this, rendererSection(renderer.get()));
+            renderer->render(_viewport);
+        }
+
+        profilerOverlay();
+
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
     }
 
-    ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    {
+        SectionScope scope(*this, _profiler.getSection("snapshots"));
+        collectSnapshots();
+    }
 
     glfwSwapInterval(_config->vsync ? 1 : 0);
 
     _viewport.setFoV(_config->fov);
 
-    controlFrameRate(_config.get());
+    {
+        SectionScope scope(*this, _profiler.getSection("frame pacing"));
+        Timer pacing;
+        controlFrameRate(_config.get());
+        pacingMs = pacing.elapsedMs();
+    }
 }
\ No newline at end of file
@@ -11,9 +11,21 @@
 #include <liteviz/core/shader.h>
 #include <liteviz/core/viewport.h>
 #include <liteviz/core/mesh.h>
+#include <liteviz/core/octree.h>
+#include <liteviz/core/frustum_set.h>
+#include <liteviz/core/anchored.h>
+#include <liteviz/core/point_store.h>
+#include <liteviz/core/scene_file.h>
+#include <liteviz/core/outofcore.h>
+#include <liteviz/core/ply.h>
 #include <liteviz/core/base_renderer.h>
 #include <liteviz/core/base_config.h>
 #include <liteviz/core/image.h>
+#include <liteviz/core/capture.h>
+#include <liteviz/core/recorder.h>
+#include <liteviz/core/profiler.h>
+#include <liteviz/core/update_queue.h>
+#include <liteviz/core/snapshot.h>
 
 namespace liteviz {
 
@@ -51,25 +63,70 @@ public:
     
     std::string getTimestamp();
 
+    // synchronous readback of the current frame, stalls until the GPU is done
     Image getFrameBuffer();
 
+    // save snapshots whose asynchronous readback has finished
+    void collectSnapshots();
+
     void configuration(BaseConfig* config);
 
     void controlFrameRate(BaseConfig* config);
 
+    // per section CPU/GPU times of the last frames, shown while profiling
+    void profilerOverlay();
+
+    // write the trace timeline to `<prefix><timestamp>.json`
+    void dumpTrace(const std::string& prefix = "trace-");
+
+    // queue a scene update from any thread, it runs on the render thread before the next frame
+    void post(UpdateQueue::Command command);
+
+    // empty scene to build snapshots from, any thread; only its descendants can be published here
+    std::shared_ptr<SceneSnapshot> createScene() const;
+
+    // hand a complete scene to the render thread, any thread; the latest one is drawn from the next frame on
+    void publish(std::shared_ptr<const SceneSnapshot> snapshot);
+
+    // any thread: draw at least one more frame when rendering on demand
+    void requestRedraw();
+
+    // GL work of the last frame drawn
+    const GLCounters& getFrameCounters() const;
+
+    // GL work of a registered renderer in the last frame drawn
+    GLCounters getRendererCounters(const BaseRenderer* renderer);
+
     void draw();
 
 protected:
 
+    // profiler scope that also counts the GL work issued inside it
+    class SectionScope {
+    public:
+        SectionScope(ViewerDetail& viewer, size_t section);
+        ~SectionScope();
+        SectionScope(const SectionScope&) = delete;
+        SectionScope& operator=(const SectionScope&) = delete;
+    private:
+        ViewerDetail& viewer;
+        size_t section;
+        GLCounters start;
+        FrameProfiler::Scope scope;
+    };
+
     virtual bool initResources() = 0;
+    void workCounters();
     void renderAll(Viewport& viewport);
+    bool needsRedraw();
+    size_t rendererSection(const BaseRenderer* renderer);
     std::vector<std::shared_ptr<BaseRenderer>> _registeredRenderers;
     std::vector<std::shared_ptr<BaseRenderer>> _registeredGUIRenderers;
     std::vector<std::shared_ptr<BaseConfig>> _registeredConfigs;
 
 public:
     std::string title;
-    GLFWwindow* window;
+    GLFWwindow* window = nullptr;
 
     Viewport _viewport;
     static ViewerDetail* _detail;
@@ -84,6 +141,57 @@ public:
     std::mutex notifier_mutex;
     std::shared_ptr<ViewerNotifier> _notifier = nullptr;
 
+    // Scene updates posted by other threads, drained for at most
+    // updateBudget seconds per frame
+    UpdateQueue _updates;
+    double updateBudget = 0.004;
+
+    // Published scene snapshots, latched once per frame in renderAll and
+    // drawn before the registered renderers
+    SceneExchange _scenes;
+    SnapshotRenderer _sceneRenderer;
+
+    // Snapshot readbacks in flight, handed to the writer with the paths in
+    // request order a frame or two later without stalling the render loop
+    FrameCapture _capture;
+    std::deque<std::string> _snapshotPaths;
+    ImageWriter _snapshotWriter;
+
+    // Frame sequence recording, captured every frame without the GUI
+    FrameRecorder _recorder;
+    int recordFormat = 0;
+
+    // Frame profiler, on while the overlay is shown; registered renderers
+    // are timed as sections named after their type
+    FrameProfiler _profiler;
+    bool showProfiler = false;
+    std::unordered_map<const BaseRenderer*, size_t> rendererSections;
+
+    // GL work counted per frame and per profiler section (see GLCounters);
+    // sections include the work of the sections nested in them
+    GLCounters frameCounters;
+    std::vector<GLCounters> sectionCounters;    // last frame, indexed like _profiler.getSections()
+    std::vector<GLCounters> countingSections;   // frame in progress
+
+    // Trace timeline (see TraceRecorder), dumped from the configuration
+    // panel or automatically when a frame's work, frame pacing excluded,
+    // takes longer than traceHitchMs; at most one hitch dump per
+    // traceHitchInterval seconds
+    bool tracing = false;
+    float traceHitchMs = 50.0f;
+    double traceHitchInterval = 5.0;
+    Timer lastTraceDump;
+    double pacingMs = 0.0;
+
+    // Render on demand: frames are drawn after a redraw request, for a few
+    // frames after input so ImGui settles, and while anything is queued,
+    // captured or dirty; otherwise the loop sleeps in glfwWaitEventsTimeout
+    // and wakes every idleTimeout seconds to poll the renderers
+    std::atomic<bool> redrawRequested{true};
+    int redrawFrames = 0;
+    int settleFrames = 3;
+    double idleTimeout = 0.05;
+
     // Control frame rate
     int targetFPS = 30;
     int frameTime;
@@ -0,0 +1,221 @@
+#ifndef __LITEVIZ_FRUSTUM_SET_H__
+#define __LITEVIZ_FRUSTUM_SET_H__
+
+#include <liteviz/core/common.h>
+#include <liteviz/core/shader.h>
+#include <liteviz/core/viewport.h>
+#include <liteviz/core/mesh.h>
+
+namespace liteviz {
+
+// Batch of camera frustums, e.g. the keyframes of a SLAM map, drawn with
+// shaders/draw_frustum.vert. The frustum shape of Frustum::setup is uploaded
+// once in a canonical form; every keyframe is one 96 byte instance record
+// (pose, intrinsics, color), so the whole set costs two instanced draws
+// (edges and axes, up marker) and changing a keyframe re-uploads its record
+// only. With a PoseBuffer attached, frustum i sits at keyframe pose i times
+// its own pose, so a trajectory update re-uploads no instance at all.
+class FrustumSet: public Mesh{
+public:
+    FrustumSet(){
+        instances.reserve(64);
+    }
+
+    // owns a GL buffer outside of VertexBuffer
+    FrustumSet(const FrustumSet&) = delete;
+    FrustumSet& operator=(const FrustumSet&) = delete;
+
+    ~FrustumSet(){
+        if(instance_buffer != 0)
+            glDeleteBuffers(1, &instance_buffer);
+    }
+
+    // returns the slot of the new frustum, `intr` and `scale` as in Frustum::setup
+    size_t add(const mat4f& pose, const vec4f& intr, const vec4f& color = COLOR_WHITE, float scale = 1.0f){
+        Instance instance;
+        instance.pose = pose;
+        instance.intrinsics = intr * scale;
+        instance.color = color;
+        instances.push_back(instance);
+        dirty.push_back(false);
+        mark(instances.size() - 1);
+        return instances.size() - 1;
+    }
+
+    void setPose(size_t slot, const mat4f& pose){
+        instances[slot].pose = pose;
+        mark(slot);
+    }
+
+    void setIntrinsics(size_t slot, const vec4f& intr, float scale = 1.0f){
+        instances[slot].intrinsics = intr * scale;
+        mark(slot);
+    }
+
+    void setColor(size_t slot, const vec4f& color){
+        instances[slot].color = color;
+        mark(slot);
+    }
+
+    void setColor(vec4f color) override {
+        for(size_t i = 0; i < instances.size(); ++i){
+            instances[i].color = color;
+            mark(i);
+        }
+    }
+
+    // take keyframe poses from `poses`, nullptr detaches; the buffer has to outlive the set
+    void setPoseBuffer(PoseBuffer* poses){
+        pose_buffer = poses;
+    }
+
+    const mat4f& getPose(size_t slot) const {
+        return instances[slot].pose;
+    }
+
+    size_t size() const {
+        return instances.size();
+    }
+
+    void clear(){
+        instances.clear();
+        dirty.clear();
+        dirty_slots.clear();
+    }
+
+    void draw(Shader* shader, const Viewport& viewport) override {
+        // draw_frustum.vert reads keyframe pose i for instance i, so anchored sets
+        // draw only the frustums whose keyframe pose is already in the buffer
+        size_t count = instances.size();
+        if(pose_buffer)
+            count = std::min(count, pose_buffer->size());
+        if(count == 0)
+            return;
+
+        mat4f transform = viewport.getProjectionMatrix() * viewport.getViewMatrix();
+
+        shader->bind(false);
+        shader->set_uniform("ProjMat", transform);
+        shader->set_uniform("Alpha", 1.0f);
+        shader->set_uniform("Anchored", pose_buffer ? 1 : 0);
+        if(pose_buffer)
+            pose_buffer->bind();
+
+        buffer.bind();
+        if(buffer.outdated(1, shader->programID())){
+            setupGeometry(shader);
+            buffer.validate(1, shader->programID(), CANONICAL_VERTICES);
+            instance_program = 0;
+        }
+        uploadInstances(shader);
+
+        shader->draw_instanced(GL_LINES, 0, LINE_VERTICES, count);
+        shader->draw_instanced(GL_TRIANGLES, LINE_VERTICES, CANONICAL_VERTICES - LINE_VERTICES, count);
+        buffer.unbind();
+        shader->unbind(false);
+    }
+
+private:
+    // matches the attribute offsets in uploadInstances()
+    struct Instance {
+        mat4f pose;
+        vec4f intrinsics;
+        vec4f color;
+    };
+
+    static constexpr size_t LINE_VERTICES = 22;
+    static constexpr size_t CANONICAL_VERTICES = 25;
+
+    void mark(size_t slot){
+        if(!dirty[slot]){
+            dirty[slot] = true;
+            dirty_slots.push_back(slot);
+        }
+    }
+
+    // vertices in units of (cx, cy, fx), the axes (w = 1) in units of cx
+    void setupGeometry(Shader* shader){
+        const vec4f corners[4] = {
+            vec4f( 1,  1, 1, 0), vec4f(-1,  1, 1, 0),
+            vec4f(-1, -1, 1, 0), vec4f( 1, -1, 1, 0),
+        };
+        std::vector<vec4f> positions;
+        for(int i = 0; i < 4; ++i){
+            positions.push_back(vec4f::Zero());
+            positions.push_back(corners[i]);
+        }
+        for(int i = 0; i < 4; ++i){
+            positions.push_back(corners[i]);
+            positions.push_back(corners[(i + 1) % 4]);
+        }
+        for(int i = 0; i < 3; ++i){
+            positions.push_back(vec4f(0, 0, 0, 1));
+            positions.push_back(vec4f(i == 0, i == 1, i == 2, 1));
+        }
+        positions.push_back(vec4f( 1.0f / 3, -1.05f, 1, 0));
+        positions.push_back(vec4f(-1.0f / 3, -1.05f, 1, 0));
+        positions.push_back(vec4f( 0, -1.25f, 1, 0));
+
+        std::vector<vec4f> colors(positions.size(), COLOR_WHITE);
+        const vec4f axis_colors[3] = {COLOR_AXIS_X, COLOR_AXIS_Y, COLOR_AXIS_Z};
+        for(int i = 0; i < 6; ++i){
+            colors[16 + i] = axis_colors[i / 2];
+        }
+
+        shader->set_attribute(buffer, "Color", colors);
+        shader->set_attribute(buffer, "Position", positions);
+    }
+
+    // grow the instance buffer if needed, otherwise send the changed slots
+    // only, coalesced into contiguous runs; expects `buffer` to be bound
+    void uploadInstances(Shader* shader){
+        if(instance_buffer == 0)
+            glGenBuffers(1, &instance_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+
+        if(instance_capacity < instances.size()){
+            instance_capacity = std::max(instances.size(), instance_capacity * 2);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(Instance) * instance_capacity, nullptr, GL_DYNAMIC_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Instance) * instances.size(), instances.data());
+            gl_counters().bytes_uploaded += sizeof(Instance) * instances.size();
+            for(size_t slot : dirty_slots)
+                dirty[slot] = false;
+            dirty_slots.clear();
+        }
+
+        std::sort(dirty_slots.begin(), dirty_slots.end());
+        for(size_t i = 0; i < dirty_slots.size();){
+            size_t first = dirty_slots[i], last = first;
+            while(++i < dirty_slots.size() && dirty_slots[i] == last + 1)
+                last = dirty_slots[i];
+            glBufferSubData(GL_ARRAY_BUFFER, sizeof(Instance) * first,
+                sizeof(Instance) * (last + 1 - first), &instances[first]);
+            gl_counters().bytes_uploaded += sizeof(Instance) * (last + 1 - first);
+        }
+        for(size_t slot : dirty_slots)
+            dirty[slot] = false;
+        dirty_slots.clear();
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // growing keeps the buffer name, so the vertex array stays valid
+        if(instance_program != shader->programID()){
+            shader->set_instance_attribute<mat4f>(instance_buffer, "Pose", sizeof(Instance), 0);
+            shader->set_instance_attribute<vec4f>(instance_buffer, "Intrinsics", sizeof(Instance), sizeof(mat4f));
+            shader->set_instance_attribute<vec4f>(instance_buffer, "InstanceColor", sizeof(Instance), sizeof(mat4f) + sizeof(vec4f));
+            instance_program = shader->programID();
+        }
+    }
+
+    std::vector<Instance> instances;
+    std::vector<bool> dirty;
+    std::vector<size_t> dirty_slots;
+
+    GLuint instance_buffer = 0;
+    size_t instance_capacity = 0;
+    GLuint instance_program = 0;      // program the instance attributes are laid out for
+    PoseBuffer* pose_buffer = nullptr;
+};
+
+} // namespace liteviz
+
+#endif // __LITEVIZ_FRUSTUM_SET_H__
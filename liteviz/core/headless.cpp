@@ -0,0 +1,232 @@
+#include <liteviz/core/headless.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <limits>
+
+liteviz::HeadlessViewer::HeadlessViewer(int width, int height, int samples):
+    _viewport(width, height), width(width), height(height), samples(samples) {
+    _viewport.frameBufferSize = _viewport.windowSize;
+    _config = std::make_shared<BaseConfig>();
+}
+
+liteviz::HeadlessViewer::~HeadlessViewer() {
+    if (!context)
+        return;
+    // GL objects of renderers and snapshots go while the context is still current
+    _registeredRenderers.clear();
+    _sceneRenderer = SnapshotRenderer();
+    _scenes.publish(nullptr);
+    _scenes.acquire();
+    capture.release();
+    releaseFramebuffer();
+
+    EGLDisplay dpy = static_cast<EGLDisplay>(display);
+    eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(dpy, static_cast<EGLContext>(context));
+    eglTerminate(dpy);
+}
+
+bool liteviz::HeadlessViewer::init() {
+
+    // Mesa's surfaceless platform needs neither a display server nor a GPU
+    EGLDisplay dpy = EGL_NO_DISPLAY;
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+        dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (dpy == EGL_NO_DISPLAY)
+        dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, &major, &minor)) {
+        std::cerr << "Failed to initialize EGL" << std::endl;
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "EGL does not support desktop OpenGL" << std::endl;
+        eglTerminate(dpy);
+        return false;
+    }
+
+    const EGLint config_attribs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config = nullptr;
+    EGLint num_configs = 0;
+    eglChooseConfig(dpy, config_attribs, &config, 1, &num_configs);
+
+    // same context as the windowed viewer asks GLFW for
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext ctx = eglCreateContext(dpy, num_configs > 0 ? config : nullptr, EGL_NO_CONTEXT, context_attribs);
+    if (ctx == EGL_NO_CONTEXT) {
+        std::cerr << "Failed to create an OpenGL 4.3 core context: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+        eglTerminate(dpy);
+        return false;
+    }
+    if (!eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx)) {
+        std::cerr << "Failed to make the context current without a surface" << std::endl;
+        eglDestroyContext(dpy, ctx);
+        eglTerminate(dpy);
+        return false;
+    }
+    display = dpy;
+    context = ctx;
+
+    gl_proc_loader() = (GLADloadproc)eglGetProcAddress;
+    if (!gladLoadGLLoader(gl_proc_loader())) {
+        std::cerr << "GLAD init failed" << std::endl;
+        return false;
+    }
+
+    glEnable(GL_LINE_SMOOTH);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBlendEquation(GL_FUNC_ADD);
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    _sceneRenderer.loadShaders(std::string(RESOURCE_DIR) + "/shaders");
+
+    createFramebuffer();
+    return true;
+}
+
+void liteviz::HeadlessViewer::resize(int width, int height) {
+    this->width = width;
+    this->height = height;
+    _viewport.windowSize = vec2i(width, height);
+    _viewport.frameBufferSize = _viewport.windowSize;
+    if (context) {
+        releaseFramebuffer();
+        createFramebuffer();
+    }
+}
+
+void liteviz::HeadlessViewer::addRenderer(std::shared_ptr<BaseRenderer> renderer) {
+    _registeredRenderers.push_back(renderer);
+}
+
+void liteviz::HeadlessViewer::post(UpdateQueue::Command command) {
+    _updates.push(std::move(command));
+}
+
+std::shared_ptr<liteviz::SceneSnapshot> liteviz::HeadlessViewer::createScene() const {
+    return _scenes.create();
+}
+
+void liteviz::HeadlessViewer::publish(std::shared_ptr<const SceneSnapshot> snapshot) {
+    _scenes.publish(std::move(snapshot));
+}
+
+void liteviz::HeadlessViewer::draw() {
+
+    // offline frames should be reproducible, so everything queued is applied
+    _updates.drain(std::numeric_limits<double>::infinity());
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+    const vec4f& bg = _config->bgColor;
+    glClearColor(bg[0], bg[1], bg[2], bg[3]);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    _viewport.setFoV(_config->fov);
+
+    _sceneRenderer.setScene(_scenes.acquire());
+    _sceneRenderer.render(_viewport);
+
+    for (const auto& renderer : _registeredRenderers) {
+        renderer->render(_viewport);
+    }
+}
+
+liteviz::Image liteviz::HeadlessViewer::render() {
+    draw();
+    return getFrameBuffer();
+}
+
+liteviz::Image liteviz::HeadlessViewer::getFrameBuffer() {
+    bindReadFramebuffer();
+
+    const size_t row_bytes = size_t(width) * 4;
+    rows.resize(row_bytes * height);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rows.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // GL rows are bottom up, flipped while copying out
+    Image img(width, height, 4);
+    for (int y = 0; y < height; ++y) {
+        std::memcpy(img.ptr() + y * row_bytes, rows.data() + (height - 1 - y) * row_bytes, row_bytes);
+    }
+    return img;
+}
+
+bool liteviz::HeadlessViewer::requestFrame(uint64_t tag) {
+    bindReadFramebuffer();
+    bool requested = capture.request(width, height, tag);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return requested;
+}
+
+bool liteviz::HeadlessViewer::collectFrame(Image& out, uint64_t* tag) {
+    return capture.collect(out, tag);
+}
+
+GLuint liteviz::HeadlessViewer::getFramebufferID() const {
+    return framebuffer;
+}
+
+void liteviz::HeadlessViewer::createFramebuffer() {
+    glGenRenderbuffers(3, renderbuffers);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Offscreen framebuffer incomplete" << std::endl;
+
+    if (samples > 0) {
+        glGenFramebuffers(1, &resolve);
+        glBindFramebuffer(GL_FRAMEBUFFER, resolve);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[2]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[2]);
+    }
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void liteviz::HeadlessViewer::bindReadFramebuffer() {
+    if (resolve != 0) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolve);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, resolve);
+    } else {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    }
+}
+
+void liteviz::HeadlessViewer::releaseFramebuffer() {
+    glDeleteRenderbuffers(3, renderbuffers);
+    glDeleteFramebuffers(1, &framebuffer);
+    if (resolve != 0)
+        glDeleteFramebuffers(1, &resolve);
+    renderbuffers[0] = renderbuffers[1] = renderbuffers[2] = 0;
+    framebuffer = 0;
+    resolve = 0;
+}
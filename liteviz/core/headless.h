@@ -0,0 +1,99 @@
+#ifndef __LITEVIZ_HEADLESS_H__
+#define __LITEVIZ_HEADLESS_H__
+
+#include <glad/glad.h>
+
+#include <liteviz/core/common.h>
+#include <liteviz/core/shader.h>
+#include <liteviz/core/viewport.h>
+#include <liteviz/core/base_renderer.h>
+#include <liteviz/core/base_config.h>
+#include <liteviz/core/image.h>
+#include <liteviz/core/capture.h>
+#include <liteviz/core/update_queue.h>
+#include <liteviz/core/snapshot.h>
+
+namespace liteviz {
+
+// Offscreen counterpart of ViewerDetail for machines without a display, e.g.
+// render farm nodes, CI containers and benchmarks. The context comes from EGL
+// (surfaceless where supported, so Mesa llvmpipe works without any GPU), the
+// renderers draw into a framebuffer object of the requested size and every
+// render() returns the frame as an Image. There is no window, input or ImGui;
+// updates and snapshots are taken like in ViewerDetail.
+// Only available when built with BUILD_HEADLESS.
+class HeadlessViewer {
+public:
+    // `samples` > 0 renders multisampled and resolves before reading back
+    HeadlessViewer(int width, int height, int samples = 0);
+
+    ~HeadlessViewer();
+
+    HeadlessViewer(const HeadlessViewer&) = delete;
+    HeadlessViewer& operator=(const HeadlessViewer&) = delete;
+
+    // create the context and the framebuffer, the context stays current on the calling thread
+    bool init();
+
+    void resize(int width, int height);
+
+    void addRenderer(std::shared_ptr<BaseRenderer> renderer);
+
+    // queue a scene update from any thread, it runs before the next render()
+    void post(UpdateQueue::Command command);
+
+    // empty scene to build snapshots from, any thread; only its descendants can be published here
+    std::shared_ptr<SceneSnapshot> createScene() const;
+
+    // hand a complete scene over from any thread, drawn from the next render() on
+    void publish(std::shared_ptr<const SceneSnapshot> snapshot);
+
+    // draw one frame into the framebuffer without reading it back
+    void draw();
+
+    // draw one frame and return it top row first, RGBA
+    Image render();
+
+    // read back the last drawn frame, top row first, RGBA
+    Image getFrameBuffer();
+
+    // start an asynchronous readback of the last drawn frame, false while every
+    // slot of the capture ring (3) holds one not collected yet; `tag` comes back with it
+    bool requestFrame(uint64_t tag = 0);
+
+    // oldest requested frame if its readback is done, top row first, RGBA
+    bool collectFrame(Image& out, uint64_t* tag = nullptr);
+
+    GLuint getFramebufferID() const;
+
+    Viewport _viewport;
+    std::shared_ptr<BaseConfig> _config;
+
+private:
+    void createFramebuffer();
+    void releaseFramebuffer();
+    void bindReadFramebuffer();
+
+    int width;
+    int height;
+    int samples;
+
+    // EGLDisplay and EGLContext, kept opaque so EGL headers stay out of here
+    void* display = nullptr;
+    void* context = nullptr;
+
+    GLuint framebuffer = 0;         // drawn to, multisampled if samples > 0
+    GLuint resolve = 0;             // single sampled copy read back from, 0 without multisampling
+    GLuint renderbuffers[3] = {0, 0, 0};
+
+    std::vector<std::shared_ptr<BaseRenderer>> _registeredRenderers;
+    UpdateQueue _updates;
+    SceneExchange _scenes;
+    SnapshotRenderer _sceneRenderer;
+    std::vector<uint8_t> rows;      // readback staging
+    FrameCapture capture;
+};
+
+} // namespace liteviz
+
+#endif // __LITEVIZ_HEADLESS_H__
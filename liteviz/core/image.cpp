@@ -0,0 +1,426 @@
+#include <liteviz/core/image.h>
+
+namespace {
+
+// ---- checksums ----
+
+struct CrcTable {
+    uint32_t table[256];
+    CrcTable() {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+    }
+};
+
+// running CRC, start with 0xFFFFFFFF and invert the result
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size) {
+    static const CrcTable crc_table;
+    for (size_t i = 0; i < size; ++i)
+        crc = crc_table.table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+const uint32_t ADLER_BASE = 65521;
+
+uint32_t adler32(const uint8_t* data, size_t size) {
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        size_t n = std::min<size_t>(size, 5552);   // largest block without overflow
+        size -= n;
+        for (size_t i = 0; i < n; ++i) {
+            a += data[i];
+            b += a;
+        }
+        data += n;
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+    }
+    return (b << 16) | a;
+}
+
+// adler32 of A followed by B from the checksums of both, as zlib's adler32_combine
+uint32_t adler32_combine(uint32_t adler_a, uint32_t adler_b, size_t size_b) {
+    uint32_t rem = uint32_t(size_b % ADLER_BASE);
+    uint32_t sum1 = adler_a & 0xFFFF;
+    uint32_t sum2 = uint32_t((uint64_t(rem) * sum1) % ADLER_BASE);
+    sum1 += (adler_b & 0xFFFF) + ADLER_BASE - 1;
+    sum2 += (adler_a >> 16) + (adler_b >> 16) + ADLER_BASE - rem;
+    if (sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+    if (sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+    if (sum2 >= 2 * ADLER_BASE) sum2 -= 2 * ADLER_BASE;
+    if (sum2 >= ADLER_BASE) sum2 -= ADLER_BASE;
+    return (sum2 << 16) | sum1;
+}
+
+void put_be32(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(uint8_t(value >> 24));
+    out.push_back(uint8_t(value >> 16));
+    out.push_back(uint8_t(value >> 8));
+    out.push_back(uint8_t(value));
+}
+
+// ---- deflate with the fixed Huffman code ----
+
+uint32_t reverse_bits(uint32_t code, int length) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; ++i) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    return reversed;
+}
+
+// codes already bit reversed, as deflate sends Huffman codes MSB first
+struct FixedCodes {
+    uint16_t literal[256];
+    uint8_t literal_bits[256];
+    uint32_t length[259];           // symbol and extra bits of every match length
+    uint8_t length_bits[259];
+
+    FixedCodes() {
+        auto symbol = [](int sym, uint32_t& code, uint8_t& bits) {
+            if (sym < 144)      { code = 0x30 + sym;          bits = 8; }
+            else if (sym < 256) { code = 0x190 + sym - 144;   bits = 9; }
+            else if (sym < 280) { code = sym - 256;           bits = 7; }
+            else                { code = 0xC0 + sym - 280;    bits = 8; }
+            code = reverse_bits(code, bits);
+        };
+        for (int i = 0; i < 256; ++i) {
+            uint32_t code; uint8_t bits;
+            symbol(i, code, bits);
+            literal[i] = uint16_t(code);
+            literal_bits[i] = bits;
+        }
+        for (int len = 3; len <= 258; ++len) {
+            int l = len - 3, sym, extra_bits = 0;
+            if (len == 258) {
+                sym = 285;
+            } else if (l < 8) {
+                sym = 257 + l;
+            } else {
+                int k = 31 - __builtin_clz(l);
+                extra_bits = k - 2;
+                sym = 257 + 4 * (k - 1) + ((l >> extra_bits) & 3);
+            }
+            uint32_t code; uint8_t bits;
+            symbol(sym, code, bits);
+            uint32_t extra = l & ((1u << extra_bits) - 1);
+            length[len] = code | (extra << bits);
+            length_bits[len] = uint8_t(bits + extra_bits);
+        }
+    }
+};
+
+const FixedCodes& fixed_codes() {
+    static const FixedCodes codes;
+    return codes;
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out): out(out) {}
+
+    void put(uint64_t value, int count) {
+        bits |= value << filled;
+        filled += count;
+        if (filled >= 32) {
+            uint8_t bytes[4] = {uint8_t(bits), uint8_t(bits >> 8), uint8_t(bits >> 16), uint8_t(bits >> 24)};
+            out.insert(out.end(), bytes, bytes + 4);
+            bits >>= 32;
+            filled -= 32;
+        }
+    }
+
+    // pad to a byte boundary
+    void flush() {
+        while (filled > 0) {
+            out.push_back(uint8_t(bits));
+            bits >>= 8;
+            filled = std::max(filled - 8, 0);
+        }
+        bits = 0;
+    }
+
+private:
+    std::vector<uint8_t>& out;
+    uint64_t bits = 0;
+    int filled = 0;
+};
+
+uint32_t load32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+size_t match_length(const uint8_t* a, const uint8_t* b, size_t limit) {
+    size_t len = 0;
+    while (len + 8 <= limit) {
+        uint64_t x, y;
+        std::memcpy(&x, a + len, 8);
+        std::memcpy(&y, b + len, 8);
+        if (x != y)
+            return len + (__builtin_ctzll(x ^ y) >> 3);
+        len += 8;
+    }
+    while (len < limit && a[len] == b[len])
+        ++len;
+    return len;
+}
+
+// one fixed Huffman block (not final) followed by an empty stored block, so
+// the output ends byte aligned and independently deflated strips concatenate
+// into a single stream
+void deflate_fixed(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    const FixedCodes& codes = fixed_codes();
+    const int HASH_BITS = 15;
+    const size_t WINDOW = 32768;
+    std::vector<int64_t> head(size_t(1) << HASH_BITS, -1);
+
+    BitWriter writer(out);
+    writer.put(2, 3);       // BFINAL 0, BTYPE 01
+
+    size_t i = 0;
+    while (i + 4 <= size) {
+        uint32_t h = (load32(data + i) * 2654435761u) >> (32 - HASH_BITS);
+        int64_t candidate = head[h];
+        head[h] = int64_t(i);
+        if (candidate >= 0 && i - candidate <= WINDOW && load32(data + candidate) == load32(data + i)) {
+            size_t len = 4 + match_length(data + candidate + 4, data + i + 4, std::min<size_t>(258, size - i) - 4);
+            uint32_t dist = uint32_t(i - candidate) - 1;
+            writer.put(codes.length[len], codes.length_bits[len]);
+            if (dist < 4) {
+                writer.put(reverse_bits(dist, 5), 5);
+            } else {
+                int k = 31 - __builtin_clz(dist);
+                int extra_bits = k - 1;
+                uint32_t code = 2 * k + ((dist >> extra_bits) & 1);
+                writer.put(reverse_bits(code, 5) | ((dist & ((1u << extra_bits) - 1)) << 5), 5 + extra_bits);
+            }
+            i += len;
+        } else {
+            writer.put(codes.literal[data[i]], codes.literal_bits[data[i]]);
+            ++i;
+        }
+    }
+    for (; i < size; ++i)
+        writer.put(codes.literal[data[i]], codes.literal_bits[data[i]]);
+
+    writer.put(0, 7);       // end of block
+    writer.put(0, 3);       // empty stored block, BFINAL 0
+    writer.flush();
+    const uint8_t sync[4] = {0x00, 0x00, 0xFF, 0xFF};
+    out.insert(out.end(), sync, sync + 4);
+}
+
+// ---- PNG strips ----
+
+// Sub or Up, whichever has the smaller sum of absolute residuals
+void filter_row(const uint8_t* row, const uint8_t* prev, size_t row_bytes, int bpp, uint8_t* out, uint8_t* scratch) {
+    uint32_t sum_sub = 0, sum_up = 0;
+    for (size_t x = 0; x < row_bytes; ++x) {
+        uint8_t sub = uint8_t(row[x] - (x >= size_t(bpp) ? row[x - bpp] : 0));
+        uint8_t up = uint8_t(row[x] - (prev ? prev[x] : 0));
+        out[1 + x] = sub;
+        scratch[x] = up;
+        sum_sub += sub < 128 ? sub : 256 - sub;
+        sum_up += up < 128 ? up : 256 - up;
+    }
+    out[0] = 1;
+    if (prev && sum_up < sum_sub) {
+        out[0] = 2;
+        std::memcpy(out + 1, scratch, row_bytes);
+    }
+}
+
+struct Strip {
+    std::vector<uint8_t> chunk;     // complete IDAT chunk
+    uint32_t adler = 1;
+    size_t size = 0;                // filtered bytes
+};
+
+void encode_strip(const liteviz::Image& img, int y0, int y1, bool first, Strip& strip) {
+    const size_t row_bytes = size_t(img.width) * img.channels;
+    std::vector<uint8_t> filtered((row_bytes + 1) * (y1 - y0));
+    std::vector<uint8_t> scratch(row_bytes);
+    for (int y = y0; y < y1; ++y) {
+        const uint8_t* row = img.ptr() + y * row_bytes;
+        const uint8_t* prev = y > 0 ? row - row_bytes : nullptr;
+        filter_row(row, prev, row_bytes, img.channels, filtered.data() + (y - y0) * (row_bytes + 1), scratch.data());
+    }
+    strip.size = filtered.size();
+    strip.adler = adler32(filtered.data(), filtered.size());
+
+    std::vector<uint8_t>& chunk = strip.chunk;
+    chunk.reserve(filtered.size() / 2 + 64);
+    chunk.resize(8);
+    std::memcpy(chunk.data() + 4, "IDAT", 4);
+    if (first) {
+        chunk.push_back(0x78);      // zlib header: deflate, 32K window, fastest
+        chunk.push_back(0x01);
+    }
+    deflate_fixed(filtered.data(), filtered.size(), chunk);
+
+    uint32_t length = uint32_t(chunk.size() - 8);
+    chunk[0] = uint8_t(length >> 24);
+    chunk[1] = uint8_t(length >> 16);
+    chunk[2] = uint8_t(length >> 8);
+    chunk[3] = uint8_t(length);
+    put_be32(chunk, ~crc32_update(0xFFFFFFFFu, chunk.data() + 4, chunk.size() - 4));
+}
+
+void put_chunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size) {
+    put_be32(out, uint32_t(size));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    put_be32(out, ~crc32_update(0xFFFFFFFFu, out.data() + start, size + 4));
+}
+
+bool write_file(const std::string& path, const std::vector<uint8_t>& data) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open " << path << " for writing" << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return bool(file);
+}
+
+} // namespace
+
+bool liteviz::ImageIO::encode_png_fast(const Image& img, std::vector<uint8_t>& out, int threads) {
+    if (img.empty() || img.channels < 1 || img.channels > 4)
+        return false;
+
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    // strips of fewer rows cost more in lost matches than they gain
+    int strips = std::max(1, std::min(threads, img.height / 16));
+
+    std::vector<Strip> parts(strips);
+    std::vector<std::thread> workers;
+    for (int i = 1; i < strips; ++i) {
+        workers.emplace_back([&, i]{
+            encode_strip(img, img.height * i / strips, img.height * (i + 1) / strips, false, parts[i]);
+        });
+    }
+    encode_strip(img, 0, img.height / strips, true, parts[0]);
+    for (auto& worker : workers)
+        worker.join();
+
+    out.clear();
+    const uint8_t signature[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+    out.insert(out.end(), signature, signature + 8);
+
+    const uint8_t color_types[5] = {0, 0, 4, 2, 6};
+    std::vector<uint8_t> header;
+    put_be32(header, uint32_t(img.width));
+    put_be32(header, uint32_t(img.height));
+    header.push_back(8);        // bit depth
+    header.push_back(color_types[img.channels]);
+    header.push_back(0);        // deflate
+    header.push_back(0);        // adaptive filtering
+    header.push_back(0);        // no interlace
+    put_chunk(out, "IHDR", header.data(), header.size());
+
+    uint32_t adler = parts[0].adler;
+    for (int i = 0; i < strips; ++i) {
+        out.insert(out.end(), parts[i].chunk.begin(), parts[i].chunk.end());
+        if (i > 0)
+            adler = adler32_combine(adler, parts[i].adler, parts[i].size);
+    }
+
+    // final empty stored block and the zlib checksum
+    std::vector<uint8_t> trailer = {0x01, 0x00, 0x00, 0xFF, 0xFF};
+    put_be32(trailer, adler);
+    put_chunk(out, "IDAT", trailer.data(), trailer.size());
+    put_chunk(out, "IEND", nullptr, 0);
+    return true;
+}
+
+bool liteviz::ImageIO::save_png_fast(const std::string& path, const Image& img, int threads) {
+    std::vector<uint8_t> data;
+    if (!encode_png_fast(img, data, threads))
+        return false;
+    return write_file(path, data);
+}
+
+bool liteviz::ImageIO::encode_qoi(const Image& img, std::vector<uint8_t>& out) {
+    if (img.empty() || (img.channels != 3 && img.channels != 4)) {
+        std::cerr << "QOI needs 3 or 4 channels" << std::endl;
+        return false;
+    }
+
+    const size_t pixels = size_t(img.width) * img.height;
+    out.clear();
+    out.reserve(14 + pixels * (img.channels + 1) + 8);
+    const uint8_t magic[4] = {'q', 'o', 'i', 'f'};
+    out.insert(out.end(), magic, magic + 4);
+    put_be32(out, uint32_t(img.width));
+    put_be32(out, uint32_t(img.height));
+    out.push_back(uint8_t(img.channels));
+    out.push_back(0);           // sRGB with linear alpha
+
+    uint8_t index[64][4] = {};
+    uint8_t prev[4] = {0, 0, 0, 255};
+    int run = 0;
+    const uint8_t* p = img.ptr();
+    for (size_t i = 0; i < pixels; ++i, p += img.channels) {
+        uint8_t px[4] = {p[0], p[1], p[2], img.channels == 4 ? p[3] : uint8_t(255)};
+
+        if (std::memcmp(px, prev, 4) == 0) {
+            if (++run == 62 || i + 1 == pixels) {
+                out.push_back(uint8_t(0xC0 | (run - 1)));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            out.push_back(uint8_t(0xC0 | (run - 1)));
+            run = 0;
+        }
+
+        int slot = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+        if (std::memcmp(index[slot], px, 4) == 0) {
+            out.push_back(uint8_t(slot));
+        } else {
+            std::memcpy(index[slot], px, 4);
+            if (px[3] == prev[3]) {
+                int8_t dr = int8_t(px[0] - prev[0]);
+                int8_t dg = int8_t(px[1] - prev[1]);
+                int8_t db = int8_t(px[2] - prev[2]);
+                int8_t dr_dg = int8_t(dr - dg);
+                int8_t db_dg = int8_t(db - dg);
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    out.push_back(uint8_t(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                    out.push_back(uint8_t(0x80 | (dg + 32)));
+                    out.push_back(uint8_t((dr_dg + 8) << 4 | (db_dg + 8)));
+                } else {
+                    const uint8_t op[4] = {0xFE, px[0], px[1], px[2]};
+                    out.insert(out.end(), op, op + 4);
+                }
+            } else {
+                const uint8_t op[5] = {0xFF, px[0], px[1], px[2], px[3]};
+                out.insert(out.end(), op, op + 5);
+            }
+        }
+        std::memcpy(prev, px, 4);
+    }
+
+    const uint8_t end[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    out.insert(out.end(), end, end + 8);
+    return true;
+}
+
+bool liteviz::ImageIO::save_qoi(const std::string& path, const Image& img) {
+    std::vector<uint8_t> data;
+    if (!encode_qoi(img, data))
+        return false;
+    return write_file(path, data);
+}
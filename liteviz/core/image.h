@@ -44,6 +44,18 @@ static inline bool save_png(const std::string& path, const Image& img) {
     return stbi_write_png(path.c_str(), img.width, img.height, img.channels, img.ptr(), stride_in_bytes) != 0;
 }
 
+// Fast writers for captures, in image.cpp. The PNG encoder filters and
+// deflates horizontal strips on `threads` threads (0: one per core) with a
+// greedy LZ77 and the fixed Huffman code, so files are somewhat larger than
+// stb's but written several times faster.
+static bool encode_png_fast(const Image& img, std::vector<uint8_t>& out, int threads = 0);
+static bool save_png_fast(const std::string& path, const Image& img, int threads = 0);
+
+// QOI (qoiformat.org), lossless and far cheaper than any deflate, for bulk
+// frame dumps; 3 or 4 channels only.
+static bool encode_qoi(const Image& img, std::vector<uint8_t>& out);
+static bool save_qoi(const std::string& path, const Image& img);
+
 static inline void flip_vertical(Image& img) {
     if (img.empty()) return;
     int row_bytes = img.width * img.channels;
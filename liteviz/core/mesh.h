@@ -49,6 +49,8 @@ public:
             glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, textureSize.x(), textureSize.y(), format, type, data);
         }
         glBindTexture(GL_TEXTURE_2D, textureID);
+        if (data)
+            gl_counters().bytes_uploaded += size_t(size.x()) * size.y() * gl_pixel_size(format, type);
     }
 
     void releaseBuffers(){
@@ -83,21 +85,67 @@ protected:
 
     mat4f model_matrix;
 
+    // bumped on every change of the CPU-side data, the GPU copy in `buffer`
+    // is only refreshed when it lags behind
+    uint64_t version = 1;
+    VertexBuffer buffer;
+
+    void touch(){
+        ++version;
+    }
+
+    // re-upload positions/colors/indices if they changed since the last draw,
+    // or only the appended tail if data was just added, expects `buffer` to be bound
+    void upload(Shader* shader){
+        if(buffer.outdated(version, shader->programID())){
+            shader->set_attribute(buffer, "Color", getColors());
+            shader->set_attribute(buffer, "Position", getPositions());
+            if(!indices.empty())
+                buffer.set_indices(getIndices());
+        }else if(buffer.vertices() < positions.size() || buffer.indices() < indices.size()){
+            shader->append_attribute(buffer, "Color", getColors(), buffer.vertices());
+            shader->append_attribute(buffer, "Position", getPositions(), buffer.vertices());
+            buffer.append_indices(getIndices(), buffer.indices());
+        }else{
+            return;
+        }
+        buffer.validate(version, shader->programID(), positions.size(), indices.size());
+    }
+
+    // add vertices behind the existing ones without invalidating what is already on the GPU,
+    // for the non-indexed primitives that are drawn straight from the vertex arrays
+    void appendVertices(const std::vector<vec3f>& pc, const std::vector<vec4f>& color){
+        if(color.size() != pc.size())
+            std::cerr << "Got " << color.size() << " colors for " << pc.size() << " appended vertices, padding with white" << std::endl;
+        positions.insert(positions.end(), pc.begin(), pc.end());
+        colors.insert(colors.end(), color.begin(), color.begin() + std::min(pc.size(), color.size()));
+        colors.resize(positions.size(), COLOR_WHITE);
+    }
+
+    void appendVertices(const std::vector<vec3f>& pc, const vec4f& color){
+        positions.insert(positions.end(), pc.begin(), pc.end());
+        colors.resize(positions.size(), color);
+    }
+
 public:
 
     Mesh(){}
+    virtual ~Mesh() = default;
     void setup(){}
 
-    void clean(){
+    // drop all geometry; subclasses with more per-vertex data clear it too
+    virtual void clean(){
         positions.clear();
         colors.clear();
         indices.clear();
+        touch();
     }
-    std::vector<vec3f> getPositions() const {return positions;}
-    std::vector<vec3f> getNormals() const {return normals;}
-    std::vector<vec4f> getColors() const {return colors;}
-    std::vector<vec2f> getTexCoords() const {return texture_coords;}
-    std::vector<GLuint> getIndices() const {return indices;}
+    // views into the mesh storage, valid until the next setup()/append()/clean()
+    const std::vector<vec3f>& getPositions() const {return positions;}
+    const std::vector<vec3f>& getNormals() const {return normals;}
+    const std::vector<vec4f>& getColors() const {return colors;}
+    const std::vector<vec2f>& getTexCoords() const {return texture_coords;}
+    const std::vector<GLuint>& getIndices() const {return indices;}
     size_t getIndicesSize() const {return indices.size();}
 
     float scale = 1.0;
@@ -114,6 +162,7 @@ public:
         for(size_t i = 0; i < positions.size(); ++i){
             colors.push_back(color);
         }
+        touch();
     };
 
     mat4f getModelMatrix(const float scale=1.0){
@@ -129,12 +178,21 @@ public:
         for(size_t i = 0; i < positions.size(); ++i){
             positions[i] = R * positions[i] + t;
         }
+        touch();
     }
 
+    uint64_t getVersion() const {return version;}
+
     bool empty(){
         return positions.empty();
     }
 
+    // copy of the CPU data, without GPU buffers, for SceneSnapshot::edit();
+    // nullptr if the mesh can't be copied. The copy is taken on the producer
+    // thread while the render thread may draw the original, so only meshes
+    // whose draw() leaves their CPU state alone may return one
+    virtual std::shared_ptr<Mesh> clone() const { return nullptr; }
+
     virtual void draw(Shader* shader, const Viewport& viewport) = 0;
 };
 
@@ -211,23 +269,23 @@ public:
             positions.push_back(grid_lines_y[i]);
             colors.push_back(vec4f{0.5, 0.5, 0.5, float(pow(level - floor(level), 0.9) * 0.25)});
         }
+    }
 
-        for (size_t i = 0; i < positions.size(); ++i){
-            indices.push_back(i);
-        }
+    std::shared_ptr<Mesh> clone() const override {
+        return std::make_shared<Grid>(*this);
     }
 
     void draw(Shader* shader, const Viewport& viewport){
         
         mat4f transform = viewport.getProjectionMatrix() * viewport.getViewMatrix();
         
-        shader->bind();
+        shader->bind(false);
         shader->set_uniform("ProjMat", transform);
-        shader->set_attribute("Color", getColors());
-        shader->set_attribute("Position", getPositions());
-        shader->set_indices(getIndices());
-        shader->draw_indexed(GL_LINES, 0, getIndicesSize());
-        shader->unbind();
+        buffer.bind();
+        upload(shader);
+        shader->draw(GL_LINES, 0, positions.size());
+        buffer.unbind();
+        shader->unbind(false);
     }
 };
 
@@ -277,20 +335,24 @@ public:
         };
     }
 
+    std::shared_ptr<Mesh> clone() const override {
+        return std::make_shared<Cube>(*this);
+    }
+
     void draw(Shader* shader, const Viewport& viewport) override {
         if (!shader) return;
 
         mat4f transform = viewport.getProjectionMatrix() * viewport.getViewMatrix();
 
         // Caller is expected to set necessary uniforms (uMVP/uModelView or ProjMat)
-        shader->bind();
+        shader->bind(false);
         shader->set_uniform("ProjMat", transform);
         shader->set_uniform("Alpha", 1.0f);
-        shader->set_attribute("Color", getColors());
-        shader->set_attribute("Position", getPositions());
-        shader->set_indices(getIndices());
-        shader->draw_indexed(GL_TRIANGLES, 0, getIndicesSize());
-        shader->unbind();
+        buffer.bind();
+        upload(shader);
+        shader->draw_indexed(GL_TRIANGLES, 0, getIndicesSize(), buffer.index_type());
+        buffer.unbind();
+        shader->unbind(false);
     }
 };
 
@@ -308,6 +370,9 @@ class Frustum: public Mesh{
     std::vector<vec4f> axis_colors;
     std::vector<GLuint> axis_indices;
 
+    VertexBuffer triangle_buffer;
+    VertexBuffer axis_buffer;
+
 public:
     void setup(const vec4f& intr, const float& scale=1.0f){
         clean();
@@ -390,38 +455,45 @@ public:
         for(size_t i = 0; i < plane_positions.size(); ++i){
             plane_colors.push_back(color);
         }
+        touch();
     };
 
+    std::shared_ptr<Mesh> clone() const override {
+        return std::make_shared<Frustum>(*this);
+    }
+
     void draw(Shader* shader, const Viewport& viewport) {
 
         mat4f transform = viewport.getProjectionMatrix() * viewport.getViewMatrix();
 
-        shader->bind();
+        shader->bind(false);
         shader->set_uniform("ProjMat", transform);
         shader->set_uniform("Alpha", 1.0f);
-        shader->set_attribute("Color", getColors());
-        shader->set_attribute("Position", getPositions());
-        shader->set_indices(getIndices());
-        shader->draw_indexed(GL_LINES, 0, getIndicesSize());
-        shader->unbind();
 
-        shader->bind();
-        shader->set_uniform("ProjMat", transform);
-        shader->set_uniform("Alpha", 1.0f);
-        shader->set_attribute("Color", triangle_colors);
-        shader->set_attribute("Position", triangle_positions);
-        shader->set_indices(triangle_indices);
-        shader->draw_indexed(GL_TRIANGLES, 0, triangle_indices.size());
-        shader->unbind();
+        buffer.bind();
+        upload(shader);
+        shader->draw_indexed(GL_LINES, 0, getIndicesSize(), buffer.index_type());
 
-        shader->bind();
-        shader->set_uniform("ProjMat", transform);
-        shader->set_uniform("Alpha", 1.0f);
-        shader->set_attribute("Color", axis_colors);
-        shader->set_attribute("Position", axis_positions);
-        shader->set_indices(axis_indices);
-        shader->draw_indexed(GL_LINES, 0, axis_indices.size());
-        shader->unbind();
+        triangle_buffer.bind();
+        if(triangle_buffer.outdated(version, shader->programID())){
+            shader->set_attribute(triangle_buffer, "Color", triangle_colors);
+            shader->set_attribute(triangle_buffer, "Position", triangle_positions);
+            triangle_buffer.set_indices(triangle_indices);
+            triangle_buffer.validate(version, shader->programID());
+        }
+        shader->draw_indexed(GL_TRIANGLES, 0, triangle_indices.size(), triangle_buffer.index_type());
+
+        axis_buffer.bind();
+        if(axis_buffer.outdated(version, shader->programID())){
+            shader->set_attribute(axis_buffer, "Color", axis_colors);
+            shader->set_attribute(axis_buffer, "Position", axis_positions);
+            axis_buffer.set_indices(axis_indices);
+            axis_buffer.validate(version, shader->programID());
+        }
+        shader->draw_indexed(GL_LINES, 0, axis_indices.size(), axis_buffer.index_type());
+
+        axis_buffer.unbind();
+        shader->unbind(false);
     }
 
     void transform(mat4f model_matrix){
@@ -442,6 +514,7 @@ public:
         for(size_t i = 0; i < axis_positions.size(); ++i){
             axis_positions[i] = R * axis_positions[i] + t;
         }
+        touch();
     }
 
 };
@@ -467,8 +540,6 @@ public:
             color.z() = static_cast<float>(rand()) / RAND_MAX;
             color.w() = 1;
             colors.push_back(color);
-
-            indices.push_back(i);
         }
     }
 
@@ -477,7 +548,6 @@ public:
         for (size_t i = 0; i < pc.size(); ++i) {
             positions.push_back(pc[i]);
             colors.push_back(color);
-            indices.push_back(positions.size() - 1);
         }
     }
 
@@ -486,30 +556,222 @@ public:
         for (size_t i = 0; i < pc.size(); ++i) {
             positions.push_back(pc[i]);
             colors.push_back(color[i]);
-            indices.push_back(positions.size() - 1);
         }
     }
 
+    // take over loaded arrays without copying them, e.g. from PlyIO
+    void setup(std::vector<vec3f>&& pc, std::vector<vec4f>&& color){
+        clean();
+        positions = std::move(pc);
+        colors = std::move(color);
+        colors.resize(positions.size(), COLOR_WHITE);
+    }
+
+    // grow the cloud, only the new points are uploaded on the next draw
+    void append(const std::vector<vec3f>& pc, const std::vector<vec4f>& color){
+        appendVertices(pc, color);
+    }
+
+    void append(const std::vector<vec3f>& pc, const vec4f color){
+        appendVertices(pc, color);
+    }
+
     void setPointSize(const int size){
         point_size = size;
     }
 
+    std::shared_ptr<Mesh> clone() const override {
+        return std::make_shared<PointCloud>(*this);
+    }
+
     void draw(Shader* shader, const Viewport& viewport){
 
         mat4f transform = viewport.getProjectionMatrix() * viewport.getViewMatrix();
 
-        shader->bind();
+        shader->bind(false);
         shader->set_uniform("ProjMat", transform);
         shader->set_uniform("Alpha", 1.0f);
         shader->set_uniform("PointSize", static_cast<float>(point_size));
-        shader->set_attribute("Color", getColors());
-        shader->set_attribute("Position", getPositions());
-        shader->set_indices(getIndices());
-        shader->draw_indexed(GL_POINTS, 0, getIndicesSize());
-        shader->unbind();
+        buffer.bind();
+        upload(shader);
+        shader->draw(GL_POINTS, 0, positions.size());
+        buffer.unbind();
+        shader->unbind(false);
+    }
+
+protected:
+    int point_size = 1;
+};
+
+// PointCloud in a compact vertex format: RGBA8 colors and 16-bit positions
+// relative to cubic chunks of `chunk_size`, dequantized in draw_point.vert
+// through PositionOffset/PositionScale. A point takes 10 bytes on the GPU
+// instead of 28 plus its index, at a resolution of chunk_size / 65535.
+// Every chunk has its own vertex buffer, appends only upload the new tail.
+// A clone shares all chunks with the original and copies one only when it
+// changes, so growing the cloud through SceneSnapshot::edit() copies and
+// uploads just the chunks the new points fall into.
+class QuantizedPointCloud: public Mesh{
+public:
+    explicit QuantizedPointCloud(float chunk_size = 16.0f): chunk_size(chunk_size) {}
+
+    void setup(const std::vector<vec3f>& pc, const std::vector<vec4f>& color){
+        clean();
+        append(pc, color);
+    }
+
+    void setup(const std::vector<vec3f>& pc, const vec4f color){
+        clean();
+        append(pc, color);
+    }
+
+    void append(const std::vector<vec3f>& pc, const std::vector<vec4f>& color){
+        if(color.size() != pc.size())
+            std::cerr << "Got " << color.size() << " colors for " << pc.size() << " appended points, padding with white" << std::endl;
+        const vec4ub white = quantize(COLOR_WHITE);
+        for (size_t i = 0; i < pc.size(); ++i) {
+            add(pc[i], i < color.size() ? quantize(color[i]) : white);
+        }
+    }
+
+    void append(const std::vector<vec3f>& pc, const vec4f color){
+        const vec4ub c = quantize(color);
+        for (size_t i = 0; i < pc.size(); ++i) {
+            add(pc[i], c);
+        }
+    }
+
+    void clean() override {
+        chunks.clear();
+        borrowed.clear();
+        lookup.clear();
+        last_chunk = -1;
+        point_count = 0;
+        touch();
+    }
+
+    // the chunk buffers see the new version and are re-uploaded by the next draw
+    void setColor(vec4f color) override {
+        const vec4ub c = quantize(color);
+        for(size_t i = 0; i < chunks.size(); ++i){
+            Chunk& chunk = writable(i);
+            std::fill(chunk.colors.begin(), chunk.colors.end(), c);
+            ++chunk.version;
+        }
+        touch();
+    }
+
+    void setPointSize(const int size){
+        point_size = size;
+    }
+
+    size_t getPointCount() const {
+        return point_count;
+    }
+
+    // vertex data held on the GPU once everything is uploaded
+    size_t getBytes() const {
+        return point_count * (sizeof(vec3us) + sizeof(vec4ub));
+    }
+
+    // the original must not change afterwards, as in a published snapshot
+    std::shared_ptr<Mesh> clone() const override {
+        auto copy = std::make_shared<QuantizedPointCloud>(chunk_size);
+        copy->chunks = chunks;
+        copy->borrowed.assign(chunks.size(), true);
+        copy->lookup = lookup;
+        copy->last_chunk = last_chunk;
+        copy->point_count = point_count;
+        copy->point_size = point_size;
+        return copy;
+    }
+
+    void draw(Shader* shader, const Viewport& viewport) override {
+
+        mat4f transform = viewport.getProjectionMatrix() * viewport.getViewMatrix();
+
+        shader->bind(false);
+        shader->set_uniform("ProjMat", transform);
+        shader->set_uniform("Alpha", 1.0f);
+        shader->set_uniform("PointSize", static_cast<float>(point_size));
+        shader->set_uniform("PositionScale", vec3f(vec3f::Constant(chunk_size)));
+        for(auto& chunk : chunks){
+            chunk->buffer.bind();
+            if(chunk->buffer.outdated(chunk->version, shader->programID())){
+                shader->set_attribute(chunk->buffer, "Color", chunk->colors);
+                shader->set_attribute(chunk->buffer, "Position", chunk->positions);
+            }else if(chunk->buffer.vertices() < chunk->positions.size()){
+                shader->append_attribute(chunk->buffer, "Color", chunk->colors, chunk->buffer.vertices());
+                shader->append_attribute(chunk->buffer, "Position", chunk->positions, chunk->buffer.vertices());
+            }
+            chunk->buffer.validate(chunk->version, shader->programID(), chunk->positions.size());
+            shader->set_uniform("PositionOffset", vec3f(chunk->cell.cast<float>() * chunk_size));
+            shader->draw(GL_POINTS, 0, chunk->positions.size());
+        }
+        glBindVertexArray(0);
+        // the program is shared with float clouds, leave it dequantizing to identity
+        shader->set_uniform("PositionOffset", vec3f(vec3f::Zero()));
+        shader->set_uniform("PositionScale", vec3f(vec3f::Ones()));
+        shader->unbind(false);
     }
 
 private:
+    // chunk buffers check their own version, which a shared chunk has in every mesh
+    struct Chunk {
+        vec3i cell;
+        std::vector<vec3us> positions;
+        std::vector<vec4ub> colors;
+        uint64_t version = 1;
+        VertexBuffer buffer;
+    };
+
+    // chunk `index` for changing it, copied first if it is still shared with
+    // the mesh this one was cloned from; the copy starts without GPU buffers
+    Chunk& writable(size_t index){
+        if(borrowed[index]){
+            chunks[index] = std::make_shared<Chunk>(*chunks[index]);
+            borrowed[index] = false;
+        }
+        return *chunks[index];
+    }
+
+    static vec4ub quantize(const vec4f& color){
+        return (color.cwiseMax(0.0f).cwiseMin(1.0f) * 255.0f).array().round().cast<uint8_t>();
+    }
+
+    void add(const vec3f& p, const vec4ub& color){
+        const vec3f scaled = p / chunk_size;
+        const vec3i cell(std::floor(scaled.x()), std::floor(scaled.y()), std::floor(scaled.z()));
+
+        // consecutive points mostly fall into the same chunk
+        if(last_chunk < 0 || chunks[last_chunk]->cell != cell){
+            // 21 bits per axis, enough for +-1M chunks
+            const uint64_t key = (uint64_t(cell.x() & 0x1fffff) << 42) |
+                                 (uint64_t(cell.y() & 0x1fffff) << 21) |
+                                  uint64_t(cell.z() & 0x1fffff);
+            auto it = lookup.find(key);
+            if(it == lookup.end()){
+                it = lookup.emplace(key, chunks.size()).first;
+                chunks.push_back(std::make_shared<Chunk>());
+                chunks.back()->cell = cell;
+                borrowed.push_back(false);
+            }
+            last_chunk = it->second;
+        }
+
+        Chunk& chunk = writable(last_chunk);
+        const vec3f local = ((scaled - cell.cast<float>()) * 65535.0f).cwiseMax(0.0f).cwiseMin(65535.0f);
+        chunk.positions.push_back(local.array().round().cast<uint16_t>());
+        chunk.colors.push_back(color);
+        ++point_count;
+    }
+
+    float chunk_size;
+    std::vector<std::shared_ptr<Chunk>> chunks;
+    std::vector<bool> borrowed;             // chunks[i] still shared with the original of a clone()
+    std::unordered_map<uint64_t, size_t> lookup;
+    int last_chunk = -1;
+    size_t point_count = 0;
     int point_size = 1;
 };
 
@@ -523,10 +785,6 @@ public:
 
         positions = pc;
         colors = color;
-
-        for(size_t i = 0; i < positions.size(); ++i){
-            indices.push_back(i);
-        }
     }
 
     void setup(const std::vector<vec3f>& pc, const vec4f color){
@@ -537,22 +795,63 @@ public:
         for (size_t i = 0; i < pc.size(); ++i) {
             positions.push_back(pc[i]);
             colors.push_back(color);
-            indices.push_back(positions.size() - 1);
         }
     }
 
+    // extend the line, vertices keep pairing up into GL_LINES segments as in setup()
+    void append(const std::vector<vec3f>& pc, const std::vector<vec4f>& color){
+        appendVertices(pc, color);
+    }
+
+    void append(const std::vector<vec3f>& pc, const vec4f color){
+        appendVertices(pc, color);
+    }
+
+    std::shared_ptr<Mesh> clone() const override {
+        return std::make_shared<Line>(*this);
+    }
+
     void draw(Shader* shader, const Viewport& viewport){
 
         mat4f transform = viewport.getProjectionMatrix() * viewport.getViewMatrix();
 
-        shader->bind();
+        shader->bind(false);
+        shader->set_uniform("ProjMat", transform);
+        shader->set_uniform("Alpha", 1.0f);
+        buffer.bind();
+        upload(shader);
+        shader->draw(GL_LINES, 0, positions.size());
+        buffer.unbind();
+        shader->unbind(false);
+    }
+};
+
+class TriangleMesh: public Mesh{
+public:
+    void setup(std::vector<vec3f>&& vertices, std::vector<vec4f>&& color, std::vector<GLuint>&& faces){
+        clean();
+        positions = std::move(vertices);
+        colors = std::move(color);
+        colors.resize(positions.size(), COLOR_WHITE);
+        indices = std::move(faces);
+    }
+
+    std::shared_ptr<Mesh> clone() const override {
+        return std::make_shared<TriangleMesh>(*this);
+    }
+
+    void draw(Shader* shader, const Viewport& viewport) override {
+
+        mat4f transform = viewport.getProjectionMatrix() * viewport.getViewMatrix();
+
+        shader->bind(false);
         shader->set_uniform("ProjMat", transform);
         shader->set_uniform("Alpha", 1.0f);
-        shader->set_attribute("Color", getColors());
-        shader->set_attribute("Position", getPositions());
-        shader->set_indices(getIndices());
-        shader->draw_indexed(GL_LINES, 0, getIndicesSize());
-        shader->unbind();
+        buffer.bind();
+        upload(shader);
+        shader->draw_indexed(GL_TRIANGLES, 0, getIndicesSize(), buffer.index_type());
+        buffer.unbind();
+        shader->unbind(false);
     }
 };
 
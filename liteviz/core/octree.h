@@ -0,0 +1,425 @@
+#ifndef __LITEVIZ_OCTREE_H__
+#define __LITEVIZ_OCTREE_H__
+
+#include <liteviz/core/common.h>
+#include <liteviz/core/shader.h>
+#include <liteviz/core/viewport.h>
+#include <liteviz/core/mesh.h>
+
+#include <unordered_set>
+
+namespace liteviz {
+
+struct OctreeNode {
+    vec3f center;
+    float half_size;
+    float spacing;                  // minimum distance between the points kept in this node
+    uint32_t first = 0;             // range of the node's points in PointOctree::order
+    uint32_t count = 0;
+    int level = 0;
+    std::array<int, 8> children;
+    // (first, count) of the points insert() added later, behind all built ones
+    std::vector<std::pair<uint32_t, uint32_t>> appended;
+    uint32_t total = 0;             // points in the node over all its ranges
+
+    OctreeNode(){
+        children.fill(-1);
+    }
+};
+
+// Nested subsampling octree in the style of Potree. Every node keeps at most
+// one point per cell of a `resolution`^3 grid over its cube and hands the rest
+// down to its children, so drawing a node together with all its ancestors
+// gives a uniformly thinned version of the cloud whose density doubles per
+// level. The points of each node are contiguous in `order`, except for those
+// added by insert(), which get extra ranges behind the built ones.
+class PointOctree {
+public:
+    void build(const std::vector<vec3f>& points, size_t leaf_size = 4096, int resolution = 128){
+        nodes.clear();
+        order.clear();
+        occupied.clear();
+        appended_ranges = 0;
+        this->leaf_size = leaf_size;
+        this->resolution = resolution;
+        if(points.empty())
+            return;
+
+        vec3f lo = points[0], hi = points[0];
+        for(const auto& p : points){
+            lo = lo.cwiseMin(p);
+            hi = hi.cwiseMax(p);
+        }
+
+        OctreeNode root;
+        root.center = 0.5f * (lo + hi);
+        root.half_size = std::max(0.5f * (hi - lo).maxCoeff(), 1e-6f);
+        nodes.push_back(root);
+
+        std::vector<uint32_t> all(points.size());
+        std::iota(all.begin(), all.end(), 0);
+
+        std::vector<std::pair<int, std::vector<uint32_t>>> tasks;
+        tasks.emplace_back(0, std::move(all));
+        order.reserve(points.size());
+
+        std::unordered_set<uint64_t> cells;
+        while(!tasks.empty()){
+            int index = tasks.back().first;
+            std::vector<uint32_t> ids = std::move(tasks.back().second);
+            tasks.pop_back();
+
+            OctreeNode& node = nodes[index];
+            node.spacing = 2.0f * node.half_size / resolution;
+            node.first = order.size();
+
+            if(ids.size() <= leaf_size || node.level >= MAX_DEPTH){
+                order.insert(order.end(), ids.begin(), ids.end());
+                node.count = node.total = ids.size();
+                continue;
+            }
+
+            std::array<std::vector<uint32_t>, 8> child_ids;
+
+            cells.clear();
+            cells.reserve(ids.size());
+            for(uint32_t id : ids){
+                const vec3f& p = points[id];
+                if(cells.insert(cell(node, p)).second)
+                    order.push_back(id);
+                else
+                    child_ids[octant(node, p)].push_back(id);
+            }
+            node.count = node.total = order.size() - node.first;
+
+            for(int octant = 0; octant < 8; ++octant){
+                if(child_ids[octant].empty())
+                    continue;
+                nodes.push_back(child(index, octant));
+                nodes[index].children[octant] = nodes.size() - 1;
+                tasks.emplace_back(nodes.size() - 1, std::move(child_ids[octant]));
+            }
+        }
+    }
+
+    // place points[first, end) in the built tree without moving the points
+    // already in it: each point takes a free grid cell of the shallowest node
+    // that has one, full leaves start passing points down, and the root grows
+    // towards points outside it. The new points are appended to `order`
+    // grouped by node, every node that got some gains one range in `appended`.
+    // `points` is the array `order` refers to.
+    void insert(const std::vector<vec3f>& points, size_t first){
+        if(nodes.empty() || first >= points.size())
+            return;
+
+        std::vector<std::vector<uint32_t>> assigned(nodes.size());
+        for(size_t id = first; id < points.size(); ++id){
+            const vec3f& p = points[id];
+            while((p - nodes[0].center).cwiseAbs().maxCoeff() > nodes[0].half_size)
+                grow(p, assigned);
+
+            int index = 0;
+            for(;;){
+                OctreeNode& node = nodes[index];
+                bool leaf = std::all_of(node.children.begin(), node.children.end(), [](int c){ return c < 0; });
+                if(leaf && (node.total + assigned[index].size() < leaf_size || node.level >= MAX_DEPTH)){
+                    auto cells = occupied.find(index);
+                    if(cells != occupied.end())
+                        cells->second.insert(cell(node, p));
+                    break;
+                }
+                if(cellsOf(index, points, assigned).insert(cell(node, p)).second)
+                    break;
+
+                int o = octant(node, p);
+                if(node.children[o] < 0){
+                    nodes.push_back(child(index, o));
+                    nodes[index].children[o] = nodes.size() - 1;
+                    assigned.emplace_back();
+                }
+                index = nodes[index].children[o];
+            }
+            assigned[index].push_back(id);
+        }
+
+        for(size_t index = 0; index < nodes.size(); ++index){
+            if(assigned[index].empty())
+                continue;
+            OctreeNode& node = nodes[index];
+            node.appended.emplace_back(order.size(), assigned[index].size());
+            node.total += assigned[index].size();
+            order.insert(order.end(), assigned[index].begin(), assigned[index].end());
+            ++appended_ranges;
+        }
+    }
+
+    bool empty() const {
+        return nodes.empty();
+    }
+
+    // ranges insert() added, each one more entry per draw of its node
+    size_t appendedRanges() const {
+        return appended_ranges;
+    }
+
+    std::vector<OctreeNode> nodes;      // nodes[0] is the root
+    std::vector<uint32_t> order;        // point indices grouped by node
+
+private:
+    // guards against stacks of duplicate points that no grid can separate
+    static constexpr int MAX_DEPTH = 20;
+
+    uint64_t cell(const OctreeNode& node, const vec3f& p) const {
+        const vec3f origin = node.center - vec3f::Constant(node.half_size);
+        vec3i c = ((p - origin) / node.spacing).cast<int>().cwiseMax(0).cwiseMin(resolution - 1);
+        return (uint64_t(c.x()) * resolution + c.y()) * resolution + c.z();
+    }
+
+    static int octant(const OctreeNode& node, const vec3f& p){
+        const vec3f& center = node.center;
+        return (p.x() > center.x()) | ((p.y() > center.y()) << 1) | ((p.z() > center.z()) << 2);
+    }
+
+    OctreeNode child(int index, int octant) const {
+        OctreeNode child;
+        child.half_size = 0.5f * nodes[index].half_size;
+        child.center = nodes[index].center + child.half_size * vec3f(
+            octant & 1 ? 1.0f : -1.0f,
+            octant & 2 ? 1.0f : -1.0f,
+            octant & 4 ? 1.0f : -1.0f);
+        child.spacing = 2.0f * child.half_size / resolution;
+        child.level = nodes[index].level + 1;
+        return child;
+    }
+
+    // grid cells taken in node `index`, collected from its points on first use
+    std::unordered_set<uint64_t>& cellsOf(int index, const std::vector<vec3f>& points,
+                                          const std::vector<std::vector<uint32_t>>& assigned){
+        auto found = occupied.find(index);
+        if(found != occupied.end())
+            return found->second;
+        const OctreeNode& node = nodes[index];
+        auto& cells = occupied[index];
+        cells.reserve(node.total + assigned[index].size());
+        auto add = [&](uint32_t begin, uint32_t count){
+            for(uint32_t i = begin; i < begin + count; ++i)
+                cells.insert(cell(node, points[order[i]]));
+        };
+        add(node.first, node.count);
+        for(const auto& range : node.appended)
+            add(range.first, range.second);
+        for(uint32_t id : assigned[index])
+            cells.insert(cell(node, points[id]));
+        return cells;
+    }
+
+    // double the root towards `p`, the old root becomes one of its children
+    void grow(const vec3f& p, std::vector<std::vector<uint32_t>>& assigned){
+        OctreeNode root;
+        root.half_size = 2.0f * nodes[0].half_size;
+        root.spacing = 2.0f * root.half_size / resolution;
+        root.center = nodes[0].center + nodes[0].half_size * vec3f(
+            p.x() > nodes[0].center.x() ? 1.0f : -1.0f,
+            p.y() > nodes[0].center.y() ? 1.0f : -1.0f,
+            p.z() > nodes[0].center.z() ? 1.0f : -1.0f);
+        for(auto& node : nodes)
+            ++node.level;
+
+        // nothing refers to the root by index but `occupied` and `assigned`
+        int moved = nodes.size();
+        root.children[octant(root, nodes[0].center)] = moved;
+        OctreeNode old = std::move(nodes[0]);
+        nodes[0] = std::move(root);
+        nodes.push_back(std::move(old));
+        std::vector<uint32_t> ids = std::move(assigned[0]);
+        assigned[0].clear();
+        assigned.push_back(std::move(ids));
+        auto cells = occupied.find(0);
+        if(cells != occupied.end()){
+            std::unordered_set<uint64_t> taken = std::move(cells->second);
+            occupied.erase(cells);
+            occupied[moved] = std::move(taken);
+        }
+    }
+
+    size_t leaf_size = 4096;
+    int resolution = 128;
+    size_t appended_ranges = 0;
+    // grid cells per node, kept between insert() calls once collected
+    std::unordered_map<int, std::unordered_set<uint64_t>> occupied;
+};
+
+// PointCloud drawn through a PointOctree. All nodes live in the cloud's single
+// vertex buffer, reordered so every node is one contiguous range; each frame
+// the visible nodes are collected largest-on-screen first until the point
+// budget is spent and drawn with a single glMultiDrawArrays. Points added with
+// append() are inserted into the existing nodes and only they are uploaded;
+// any other change, or too many appended ranges, rebuilds the octree.
+class LODPointCloud: public PointCloud {
+public:
+    // upper bound of points drawn per frame
+    void setPointBudget(size_t budget){
+        point_budget = budget;
+    }
+
+    // nodes are not refined once their point spacing projects below this many pixels
+    void setMinSpacing(float pixels){
+        min_spacing = pixels;
+    }
+
+    size_t getVisiblePoints() const {
+        return visible_points;
+    }
+
+    size_t getVisibleNodes() const {
+        return visible_nodes;
+    }
+
+    const PointOctree& getOctree() const {
+        return octree;
+    }
+
+    // draw() rebuilds the octree and selects nodes, no copies behind its back
+    std::shared_ptr<Mesh> clone() const override {
+        return nullptr;
+    }
+
+    void draw(Shader* shader, const Viewport& viewport) override {
+
+        if(built_version != version || built_size > positions.size() || octree.empty())
+            rebuild();
+        else if(built_size < positions.size())
+            insert();
+        if(octree.empty())
+            return;
+
+        select(viewport);
+
+        mat4f transform = viewport.getProjectionMatrix() * viewport.getViewMatrix();
+
+        shader->bind(false);
+        shader->set_uniform("ProjMat", transform);
+        shader->set_uniform("Alpha", 1.0f);
+        shader->set_uniform("PointSize", static_cast<float>(point_size));
+        buffer.bind();
+        upload(shader);
+        shader->draw_multi(GL_POINTS, firsts.data(), counts.data(), firsts.size());
+        buffer.unbind();
+        shader->unbind(false);
+    }
+
+private:
+    // reorder the mesh storage into octree node order
+    void rebuild(){
+        octree.build(positions);
+
+        std::vector<vec3f> sorted_positions(positions.size());
+        std::vector<vec4f> sorted_colors(colors.size());
+        for(size_t i = 0; i < octree.order.size(); ++i){
+            sorted_positions[i] = positions[octree.order[i]];
+            if(!colors.empty())
+                sorted_colors[i] = colors[octree.order[i]];
+        }
+        positions.swap(sorted_positions);
+        colors.swap(sorted_colors);
+
+        // the cloud is stored in node order from now on
+        std::iota(octree.order.begin(), octree.order.end(), 0);
+
+        touch();
+        built_version = version;
+        built_size = positions.size();
+    }
+
+    // place the points appended since the last draw, regrouped by node behind
+    // the built ones, so upload() only sends them
+    void insert(){
+        octree.insert(positions, built_size);
+        if(octree.appendedRanges() > 8 * octree.nodes.size()){
+            // scattered ranges cost more per draw than one re-upload
+            rebuild();
+            return;
+        }
+
+        std::vector<vec3f> tail_positions(positions.size() - built_size);
+        std::vector<vec4f> tail_colors(colors.size() > built_size ? tail_positions.size() : 0);
+        for(size_t i = built_size; i < positions.size(); ++i){
+            tail_positions[i - built_size] = positions[octree.order[i]];
+            if(!tail_colors.empty())
+                tail_colors[i - built_size] = colors[octree.order[i]];
+            octree.order[i] = i;
+        }
+        std::copy(tail_positions.begin(), tail_positions.end(), positions.begin() + built_size);
+        std::copy(tail_colors.begin(), tail_colors.end(), colors.begin() + built_size);
+        built_size = positions.size();
+    }
+
+    void select(const Viewport& viewport){
+        const ViewFrustum frustum(viewport);
+        const auto& nodes = octree.nodes;
+
+        firsts.clear();
+        counts.clear();
+        visible_points = 0;
+        visible_nodes = 0;
+
+        auto priority = [&](int index){
+            const OctreeNode& node = nodes[index];
+            float radius = node.half_size * 1.7320508f;
+            return frustum.projectedSize(node.center, radius, radius);
+        };
+
+        queue.clear();
+        if(frustum.intersects(nodes[0].center, vec3f::Constant(nodes[0].half_size)))
+            queue.emplace_back(priority(0), 0);
+
+        while(!queue.empty()){
+            std::pop_heap(queue.begin(), queue.end());
+            const OctreeNode& node = nodes[queue.back().second];
+            queue.pop_back();
+
+            if(visible_points + node.total > point_budget)
+                continue;
+            if(node.count > 0){
+                firsts.push_back(node.first);
+                counts.push_back(node.count);
+            }
+            for(const auto& range : node.appended){
+                firsts.push_back(range.first);
+                counts.push_back(range.second);
+            }
+            visible_points += node.total;
+            ++visible_nodes;
+
+            float radius = node.half_size * 1.7320508f;
+            if(frustum.projectedSize(node.center, radius, node.spacing) < min_spacing)
+                continue;
+
+            for(int child : node.children){
+                if(child < 0)
+                    continue;
+                if(!frustum.intersects(nodes[child].center, vec3f::Constant(nodes[child].half_size)))
+                    continue;
+                queue.emplace_back(priority(child), child);
+                std::push_heap(queue.begin(), queue.end());
+            }
+        }
+    }
+
+    PointOctree octree;
+    uint64_t built_version = 0;
+    size_t built_size = 0;
+
+    size_t point_budget = 5000000;
+    float min_spacing = 1.0f;
+
+    size_t visible_points = 0;
+    size_t visible_nodes = 0;
+    std::vector<GLint> firsts;
+    std::vector<GLsizei> counts;
+    std::vector<std::pair<float, int>> queue;   // max-heap on projected size
+};
+
+} // namespace liteviz
+
+#endif // __LITEVIZ_OCTREE_H__
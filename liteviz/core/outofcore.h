@@ -0,0 +1,340 @@
+#ifndef __LITEVIZ_OUTOFCORE_H__
+#define __LITEVIZ_OUTOFCORE_H__
+
+#include <liteviz/core/common.h>
+#include <liteviz/core/shader.h>
+#include <liteviz/core/viewport.h>
+#include <liteviz/core/mesh.h>
+#include <liteviz/core/octree.h>
+#include <liteviz/core/scene_file.h>
+
+#include <deque>
+#include <set>
+
+namespace liteviz {
+
+// Point cloud that is partitioned on disk and streamed on demand. partition()
+// writes the cloud as a SceneFile block with PointOctree chunks; at runtime
+// the file is only mapped, a background thread copies out the chunks the
+// current view asks for (largest on screen first) and the render thread
+// uploads them into a GPU cache of fixed size, evicting the least recently
+// drawn chunks. Memory use is bounded by the GPU budget plus a few chunks in
+// flight, whatever the size of the file.
+class OutOfCorePointCloud: public Mesh {
+public:
+    // writes `positions`/`colors` as a scene file with LOD chunks readable by open()
+    static bool partition(const std::string& path,
+                          const std::vector<vec3f>& positions,
+                          const std::vector<vec4f>& colors,
+                          size_t leaf_size = 65536){
+        SceneWriter writer;
+        writer.addLOD("points", positions, colors, leaf_size);
+        return writer.write(path);
+    }
+
+    OutOfCorePointCloud() = default;
+
+    ~OutOfCorePointCloud(){
+        close();
+    }
+
+    // streams the first block of the scene file at `path` that carries LOD chunks
+    bool open(const std::string& path, size_t gpu_budget = size_t(512) << 20){
+        close();
+
+        auto scene = std::make_shared<SceneFile>();
+        if(!scene->open(path))
+            return false;
+
+        block = -1;
+        for(size_t i = 0; i < scene->blockCount() && block < 0; ++i){
+            if(scene->block(i).chunk_count > 0)
+                block = i;
+        }
+        if(block < 0){
+            std::cerr << "No LOD chunks in scene file: " << path << std::endl;
+            return false;
+        }
+
+        file = scene;
+        chunks.resize(file->block(block).chunk_count);
+        for(size_t i = 0; i < chunks.size(); ++i){
+            chunks[i].node = file->chunks(block)[i].node();
+        }
+
+        this->gpu_budget = gpu_budget;
+        stopping = false;
+        loader = std::thread([this](){ loaderLoop(); });
+        return true;
+    }
+
+    void close(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        if(loader.joinable())
+            loader.join();
+
+        chunks.clear();
+        file.reset();
+        requests.clear();
+        loaded.clear();
+        in_flight.clear();
+        resident_bytes = 0;
+    }
+
+    void setPointSize(const int size){
+        point_size = size;
+    }
+
+    // chunks are not refined once their point spacing projects below this many pixels
+    void setMinSpacing(float pixels){
+        min_spacing = pixels;
+    }
+
+    // bytes of chunk data uploaded per frame at most, bounds the hitch when a lot arrives at once
+    void setUploadBudget(size_t bytes){
+        upload_budget = bytes;
+    }
+
+    size_t getResidentBytes() const {
+        return resident_bytes;
+    }
+
+    size_t getVisiblePoints() const {
+        return visible_points;
+    }
+
+    size_t getPendingLoads() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return requests.size() + in_flight.size();
+    }
+
+    void draw(Shader* shader, const Viewport& viewport) override {
+        if(chunks.empty())
+            return;
+
+        ++frame;
+        select(viewport);
+        uploadLoaded(shader);
+
+        mat4f transform = viewport.getProjectionMatrix() * viewport.getViewMatrix();
+
+        shader->bind(false);
+        shader->set_uniform("ProjMat", transform);
+        shader->set_uniform("Alpha", 1.0f);
+        shader->set_uniform("PointSize", static_cast<float>(point_size));
+
+        visible_points = 0;
+        for(int index : wanted){
+            Chunk& chunk = chunks[index];
+            if(!chunk.buffer)
+                continue;
+            chunk.last_used = frame;
+            chunk.buffer->bind();
+            shader->draw(GL_POINTS, 0, chunk.node.count);
+            visible_points += chunk.node.count;
+        }
+        glBindVertexArray(0);
+        shader->unbind(false);
+    }
+
+private:
+    struct Chunk {
+        OctreeNode node;
+        std::unique_ptr<VertexBuffer> buffer;   // set while resident on the GPU
+        uint64_t last_used = 0;
+        uint64_t wanted = 0;                    // last frame select() picked the chunk
+    };
+
+    struct LoadedChunk {
+        int index;
+        std::vector<vec3f> positions;
+        std::vector<vec4f> colors;
+    };
+
+    static constexpr size_t BYTES_PER_POINT = sizeof(vec3f) + sizeof(vec4f);
+    static constexpr size_t MAX_LOADED = 8;     // chunks read but not yet uploaded
+
+    // pick the chunks this view wants and hand the missing ones to the loader
+    void select(const Viewport& viewport){
+        const ViewFrustum frustum(viewport);
+
+        wanted.clear();
+        missing.clear();
+        heap.clear();
+
+        auto priority = [&](int index){
+            const OctreeNode& node = chunks[index].node;
+            float radius = node.half_size * 1.7320508f;
+            return frustum.projectedSize(node.center, radius, radius);
+        };
+
+        const OctreeNode& root = chunks[0].node;
+        if(frustum.intersects(root.center, vec3f::Constant(root.half_size)))
+            heap.emplace_back(priority(0), 0);
+
+        size_t wanted_bytes = 0;
+        while(!heap.empty()){
+            std::pop_heap(heap.begin(), heap.end());
+            auto [size, index] = heap.back();
+            heap.pop_back();
+
+            const OctreeNode& node = chunks[index].node;
+            size_t bytes = node.count * BYTES_PER_POINT;
+            if(wanted_bytes + bytes > gpu_budget)
+                continue;
+            wanted_bytes += bytes;
+            wanted.push_back(index);
+            // marked before uploads evict, so this frame's chunks are never the victims
+            chunks[index].wanted = frame;
+            if(chunks[index].buffer)
+                chunks[index].last_used = frame;
+            else
+                missing.emplace_back(size, index);
+
+            float radius = node.half_size * 1.7320508f;
+            if(frustum.projectedSize(node.center, radius, node.spacing) < min_spacing)
+                continue;
+
+            for(int child : node.children){
+                if(child < 0)
+                    continue;
+                const OctreeNode& c = chunks[child].node;
+                if(!frustum.intersects(c.center, vec3f::Constant(c.half_size)))
+                    continue;
+                heap.emplace_back(priority(child), child);
+                std::push_heap(heap.begin(), heap.end());
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.clear();
+            for(const auto& request : missing){
+                if(in_flight.count(request.second) == 0)
+                    requests.push_back(request);
+            }
+        }
+        cv.notify_one();
+    }
+
+    void uploadLoaded(Shader* shader){
+        size_t uploaded = 0;
+        while(uploaded < upload_budget){
+            LoadedChunk data;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(loaded.empty())
+                    break;
+                data = std::move(loaded.front());
+                loaded.pop_front();
+                in_flight.erase(data.index);
+            }
+            cv.notify_one();
+
+            Chunk& chunk = chunks[data.index];
+            size_t bytes = chunk.node.count * BYTES_PER_POINT;
+            if(chunk.buffer)
+                continue;
+            if(!evict(bytes)){
+                // keep a chunk that is still wanted for a later frame instead of reading it again,
+                // one the view moved away from is dropped
+                if(chunk.wanted == frame){
+                    std::lock_guard<std::mutex> lock(mutex);
+                    in_flight.insert(data.index);
+                    loaded.push_front(std::move(data));
+                    break;
+                }
+                continue;
+            }
+
+            chunk.buffer = std::make_unique<VertexBuffer>();
+            chunk.buffer->bind();
+            shader->set_attribute(*chunk.buffer, "Position", data.positions);
+            shader->set_attribute(*chunk.buffer, "Color", data.colors);
+            chunk.buffer->unbind();
+            chunk.last_used = frame;
+            resident_bytes += bytes;
+            uploaded += bytes;
+        }
+    }
+
+    // free least recently drawn chunks until `bytes` fit, never touching this frame's chunks
+    bool evict(size_t bytes){
+        while(resident_bytes + bytes > gpu_budget){
+            int victim = -1;
+            for(size_t i = 0; i < chunks.size(); ++i){
+                if(!chunks[i].buffer || chunks[i].last_used >= frame)
+                    continue;
+                if(victim < 0 || chunks[i].last_used < chunks[victim].last_used)
+                    victim = i;
+            }
+            if(victim < 0)
+                return false;
+            chunks[victim].buffer.reset();
+            resident_bytes -= chunks[victim].node.count * BYTES_PER_POINT;
+        }
+        return true;
+    }
+
+    // copying out of the mapping here keeps the page faults off the render thread
+    void loaderLoop(){
+        while(true){
+            LoadedChunk data;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this](){
+                    return stopping || (!requests.empty() && loaded.size() < MAX_LOADED);
+                });
+                if(stopping)
+                    return;
+                auto best = std::max_element(requests.begin(), requests.end());
+                data.index = best->second;
+                requests.erase(best);
+                in_flight.insert(data.index);
+            }
+
+            const OctreeNode& node = chunks[data.index].node;
+            const vec3f* positions = file->positions(block) + node.first;
+            const vec4f* colors = file->colors(block) + node.first;
+            data.positions.assign(positions, positions + node.count);
+            data.colors.assign(colors, colors + node.count);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            loaded.push_back(std::move(data));
+        }
+    }
+
+    std::shared_ptr<SceneFile> file;
+    int block = -1;
+    std::vector<Chunk> chunks;
+
+    int point_size = 1;
+    float min_spacing = 1.0f;
+    size_t gpu_budget = 0;
+    size_t upload_budget = size_t(32) << 20;
+    size_t resident_bytes = 0;
+    size_t visible_points = 0;
+    uint64_t frame = 0;
+
+    // render thread scratch, reused between frames
+    std::vector<int> wanted;
+    std::vector<std::pair<float, int>> missing;
+    std::vector<std::pair<float, int>> heap;
+
+    // shared with the loader thread
+    std::thread loader;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+    std::vector<std::pair<float, int>> requests;
+    std::deque<LoadedChunk> loaded;
+    std::set<int> in_flight;
+};
+
+} // namespace liteviz
+
+#endif // __LITEVIZ_OUTOFCORE_H__
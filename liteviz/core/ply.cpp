@@ -0,0 +1,441 @@
+#include <liteviz/core/ply.h>
+
+#include <tinyply.h>
+
+#include <atomic>
+#include <cctype>
+#include <charconv>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+using liteviz::vec3f;
+using liteviz::vec4f;
+using tinyply::Type;
+
+size_t type_size(Type type) {
+    switch (type) {
+        case Type::INT8:    case Type::UINT8:   return 1;
+        case Type::INT16:   case Type::UINT16:  return 2;
+        case Type::INT32:   case Type::UINT32:  case Type::FLOAT32: return 4;
+        case Type::FLOAT64: return 8;
+        default: return 0;
+    }
+}
+
+template <typename T> T load_scalar(const uint8_t* ptr, bool swap) {
+    T value;
+    if (swap) {
+        uint8_t bytes[sizeof(T)];
+        std::reverse_copy(ptr, ptr + sizeof(T), bytes);
+        std::memcpy(&value, bytes, sizeof(T));
+    } else {
+        std::memcpy(&value, ptr, sizeof(T));
+    }
+    return value;
+}
+
+double load_binary(const uint8_t* ptr, Type type, bool swap) {
+    switch (type) {
+        case Type::INT8:    return *reinterpret_cast<const int8_t*>(ptr);
+        case Type::UINT8:   return *ptr;
+        case Type::INT16:   return load_scalar<int16_t>(ptr, swap);
+        case Type::UINT16:  return load_scalar<uint16_t>(ptr, swap);
+        case Type::INT32:   return load_scalar<int32_t>(ptr, swap);
+        case Type::UINT32:  return load_scalar<uint32_t>(ptr, swap);
+        case Type::FLOAT32: return load_scalar<float>(ptr, swap);
+        case Type::FLOAT64: return load_scalar<double>(ptr, swap);
+        default: return 0.0;
+    }
+}
+
+bool is_float(Type type) {
+    return type == Type::FLOAT32 || type == Type::FLOAT64;
+}
+
+// read-only view of the whole file
+struct MappedFile {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (ptr == MAP_FAILED)
+            return false;
+        madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+        data = static_cast<const uint8_t*>(ptr);
+        size = st.st_size;
+        return true;
+    }
+
+    ~MappedFile() {
+        if (data)
+            munmap(const_cast<uint8_t*>(data), size);
+    }
+};
+
+// where each vertex attribute sits in a row
+struct VertexLayout {
+    int position[3] = {-1, -1, -1};
+    int color[4] = {-1, -1, -1, -1};
+    float color_scale = 1.0f;
+};
+
+VertexLayout vertex_layout(const tinyply::PlyElement& element) {
+    VertexLayout layout;
+    const char* position_names[3] = {"x", "y", "z"};
+    const char* color_names[2][4] = {
+        {"red", "green", "blue", "alpha"},
+        {"r", "g", "b", "a"}
+    };
+    for (size_t i = 0; i < element.properties.size(); ++i) {
+        const auto& name = element.properties[i].name;
+        for (int k = 0; k < 3; ++k) {
+            if (name == position_names[k])
+                layout.position[k] = i;
+        }
+        for (int k = 0; k < 4; ++k) {
+            if (name == color_names[0][k] || name == color_names[1][k] || name == std::string("diffuse_") + color_names[0][k])
+                layout.color[k] = i;
+        }
+    }
+    if (layout.color[0] >= 0 && !is_float(element.properties[layout.color[0]].propertyType))
+        layout.color_scale = 1.0f / 255.0f;
+    return layout;
+}
+
+// run fn(begin, end) over [0, count) on all cores
+template <typename F> void parallel_for(size_t count, F fn) {
+    size_t workers = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), count / 65536 + 1));
+    if (workers == 1) {
+        fn(size_t(0), count);
+        return;
+    }
+    std::vector<std::thread> threads;
+    size_t step = (count + workers - 1) / workers;
+    for (size_t begin = 0; begin < count; begin += step) {
+        threads.emplace_back(fn, begin, std::min(count, begin + step));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// false if the polygon refers past the `vertices` of the file
+bool append_polygon(const std::vector<GLuint>& polygon, size_t vertices, std::vector<GLuint>& indices) {
+    for (GLuint index : polygon) {
+        if (index >= vertices)
+            return false;
+    }
+    for (size_t k = 2; k < polygon.size(); ++k) {
+        indices.push_back(polygon[0]);
+        indices.push_back(polygon[k - 1]);
+        indices.push_back(polygon[k]);
+    }
+    return true;
+}
+
+size_t vertex_count(const std::vector<tinyply::PlyElement>& elements) {
+    for (const auto& element : elements) {
+        if (element.name == "vertex")
+            return element.size;
+    }
+    return 0;
+}
+
+const char* skip_line(const char* ptr, const char* end) {
+    const char* eol = static_cast<const char*>(std::memchr(ptr, '\n', end - ptr));
+    return eol ? eol + 1 : end;
+}
+
+// next whitespace separated token of the line [cursor, eol), empty at the end of the line
+std::pair<const char*, const char*> next_token(const char*& cursor, const char* eol) {
+    while (cursor < eol && std::isspace(static_cast<unsigned char>(*cursor)))
+        ++cursor;
+    const char* begin = cursor;
+    while (cursor < eol && !std::isspace(static_cast<unsigned char>(*cursor)))
+        ++cursor;
+    return {begin, cursor};
+}
+
+// the mapping is not NUL terminated, so numbers are only ever parsed within the line
+bool parse_float(const char*& cursor, const char* eol, float& value) {
+    auto [begin, stop] = next_token(cursor, eol);
+    char buffer[64];
+    size_t length = stop - begin;
+    if (length == 0 || length >= sizeof(buffer))
+        return false;
+    std::memcpy(buffer, begin, length);
+    buffer[length] = '\0';
+    char* parsed = nullptr;
+    value = std::strtof(buffer, &parsed);
+    return parsed == buffer + length;
+}
+
+template <typename T> bool parse_integer(const char*& cursor, const char* eol, T& value) {
+    auto [begin, stop] = next_token(cursor, eol);
+    auto result = std::from_chars(begin, stop, value);
+    return begin != stop && result.ec == std::errc() && result.ptr == stop;
+}
+
+bool read_binary(const uint8_t* ptr, const uint8_t* end, bool swap,
+                 const std::vector<tinyply::PlyElement>& elements,
+                 std::vector<vec3f>& positions, std::vector<vec4f>& colors, std::vector<GLuint>& indices) {
+    std::vector<GLuint> polygon;
+    size_t vertices = vertex_count(elements);
+    for (const auto& element : elements) {
+        if (element.name == "vertex") {
+            std::vector<size_t> offsets;
+            size_t stride = 0;
+            for (const auto& property : element.properties) {
+                offsets.push_back(stride);
+                stride += type_size(property.propertyType);
+            }
+            if (stride == 0 || element.size > size_t(end - ptr) / stride)
+                return false;
+
+            VertexLayout layout = vertex_layout(element);
+            positions.resize(element.size);
+            colors.resize(element.size, COLOR_WHITE);
+            parallel_for(element.size, [&](size_t begin, size_t stop) {
+                for (size_t i = begin; i < stop; ++i) {
+                    const uint8_t* row = ptr + stride * i;
+                    for (int k = 0; k < 3; ++k) {
+                        int p = layout.position[k];
+                        if (p >= 0)
+                            positions[i][k] = load_binary(row + offsets[p], element.properties[p].propertyType, swap);
+                    }
+                    for (int k = 0; k < 4; ++k) {
+                        int p = layout.color[k];
+                        if (p >= 0)
+                            colors[i][k] = load_binary(row + offsets[p], element.properties[p].propertyType, swap) * layout.color_scale;
+                    }
+                }
+            });
+            ptr += stride * element.size;
+            continue;
+        }
+
+        // variable sized rows, walked one by one
+        for (size_t i = 0; i < element.size; ++i) {
+            for (const auto& property : element.properties) {
+                if (!property.isList) {
+                    if (type_size(property.propertyType) > size_t(end - ptr))
+                        return false;
+                    ptr += type_size(property.propertyType);
+                    continue;
+                }
+                size_t count_size = type_size(property.listType);
+                size_t item_size = type_size(property.propertyType);
+                if (count_size == 0 || item_size == 0 || count_size > size_t(end - ptr))
+                    return false;
+                size_t count = load_binary(ptr, property.listType, swap);
+                ptr += count_size;
+                if (count > size_t(end - ptr) / item_size)
+                    return false;
+                if (element.name == "face" && (property.name == "vertex_indices" || property.name == "vertex_index")) {
+                    polygon.resize(count);
+                    for (size_t k = 0; k < count; ++k) {
+                        polygon[k] = load_binary(ptr + k * item_size, property.propertyType, swap);
+                    }
+                    if (!append_polygon(polygon, vertices, indices))
+                        return false;
+                }
+                ptr += count * item_size;
+            }
+        }
+    }
+    return true;
+}
+
+bool read_ascii(const char* ptr, const char* end,
+                const std::vector<tinyply::PlyElement>& elements,
+                std::vector<vec3f>& positions, std::vector<vec4f>& colors, std::vector<GLuint>& indices) {
+    std::vector<GLuint> polygon;
+    size_t vertices = vertex_count(elements);
+    for (const auto& element : elements) {
+        if (element.name == "vertex") {
+            // every vertex takes at least a byte, which bounds the count from the header
+            if (element.size > size_t(end - ptr))
+                return false;
+            // finding the line starts is a cheap memchr scan, parsing them is what gets spread over the cores
+            std::vector<const char*> lines(element.size + 1);
+            for (size_t i = 0; i < element.size; ++i) {
+                if (ptr >= end)
+                    return false;
+                lines[i] = ptr;
+                ptr = skip_line(ptr, end);
+            }
+            lines[element.size] = ptr;
+
+            VertexLayout layout = vertex_layout(element);
+            positions.resize(element.size);
+            colors.resize(element.size, COLOR_WHITE);
+            std::atomic<bool> valid{true};
+            parallel_for(element.size, [&](size_t begin, size_t stop) {
+                std::vector<float> values(element.properties.size());
+                for (size_t i = begin; i < stop; ++i) {
+                    const char* cursor = lines[i];
+                    for (auto& value : values) {
+                        if (!parse_float(cursor, lines[i + 1], value)) {
+                            valid = false;
+                            return;
+                        }
+                    }
+                    for (int k = 0; k < 3; ++k) {
+                        if (layout.position[k] >= 0)
+                            positions[i][k] = values[layout.position[k]];
+                    }
+                    for (int k = 0; k < 4; ++k) {
+                        if (layout.color[k] >= 0)
+                            colors[i][k] = values[layout.color[k]] * layout.color_scale;
+                    }
+                }
+            });
+            if (!valid)
+                return false;
+            continue;
+        }
+
+        for (size_t i = 0; i < element.size; ++i) {
+            if (ptr >= end)
+                return false;
+            const char* next = skip_line(ptr, end);
+            if (element.name == "face") {
+                const char* cursor = ptr;
+                for (const auto& property : element.properties) {
+                    if (!property.isList) {
+                        float ignored;
+                        if (!parse_float(cursor, next, ignored))
+                            return false;
+                        continue;
+                    }
+                    size_t count = 0;
+                    if (!parse_integer(cursor, next, count))
+                        return false;
+                    polygon.clear();
+                    for (size_t k = 0; k < count; ++k) {
+                        GLuint index = 0;
+                        if (!parse_integer(cursor, next, index))
+                            return false;
+                        polygon.push_back(index);
+                    }
+                    if ((property.name == "vertex_indices" || property.name == "vertex_index") &&
+                        !append_polygon(polygon, vertices, indices))
+                        return false;
+                }
+            }
+            ptr = next;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool liteviz::PlyIO::load(const std::string& path,
+                          std::vector<vec3f>& positions,
+                          std::vector<vec4f>& colors,
+                          std::vector<GLuint>& indices,
+                          PlyStats* stats) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Failed to open PLY file: " << path << std::endl;
+        return false;
+    }
+
+    const char* text = reinterpret_cast<const char*>(file.data);
+    const char* end = text + file.size;
+    const char* marker = nullptr;
+    for (const char* line = text; line < end; line = skip_line(line, end)) {
+        if (end - line >= 10 && std::strncmp(line, "end_header", 10) == 0) {
+            marker = line;
+            break;
+        }
+    }
+    if (file.size < 3 || std::strncmp(text, "ply", 3) != 0 || !marker) {
+        std::cerr << "Not a PLY file: " << path << std::endl;
+        return false;
+    }
+    const char* body = skip_line(marker, end);
+
+    std::string header(text, body);
+    std::istringstream header_stream(header);
+    tinyply::PlyFile ply;
+    if (!ply.parse_header(header_stream)) {
+        std::cerr << "Invalid PLY header: " << path << std::endl;
+        return false;
+    }
+    const std::vector<tinyply::PlyElement> elements = ply.get_elements();
+    for (const auto& element : elements) {
+        // the readers fill positions from fixed size vertex rows only
+        bool lists = std::any_of(element.properties.begin(), element.properties.end(),
+            [](const tinyply::PlyProperty& p) { return p.isList; });
+        if (element.name == "vertex" && lists) {
+            std::cerr << "Unsupported PLY vertex layout with list properties: " << path << std::endl;
+            return false;
+        }
+    }
+
+    bool binary = header.find("format binary_") != std::string::npos;
+    bool big_endian = header.find("format binary_big_endian") != std::string::npos;
+    const uint16_t probe = 1;
+    bool host_big_endian = *reinterpret_cast<const uint8_t*>(&probe) == 0;
+
+    positions.clear();
+    colors.clear();
+    indices.clear();
+
+    bool ok = binary
+        ? read_binary(reinterpret_cast<const uint8_t*>(body), file.data + file.size, big_endian != host_big_endian,
+                      elements, positions, colors, indices)
+        : read_ascii(body, end, elements, positions, colors, indices);
+    if (!ok) {
+        std::cerr << "Truncated or malformed PLY file: " << path << std::endl;
+        return false;
+    }
+
+    if (stats) {
+        stats->bytes = file.size;
+        stats->vertices = positions.size();
+        stats->faces = indices.size() / 3;
+        stats->binary = binary;
+        stats->seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    return true;
+}
+
+bool liteviz::PlyIO::load(const std::string& path, PointCloud& cloud, PlyStats* stats) {
+    std::vector<vec3f> positions;
+    std::vector<vec4f> colors;
+    std::vector<GLuint> indices;
+    if (!load(path, positions, colors, indices, stats))
+        return false;
+    cloud.setup(std::move(positions), std::move(colors));
+    return true;
+}
+
+bool liteviz::PlyIO::load(const std::string& path, TriangleMesh& mesh, PlyStats* stats) {
+    std::vector<vec3f> positions;
+    std::vector<vec4f> colors;
+    std::vector<GLuint> indices;
+    if (!load(path, positions, colors, indices, stats))
+        return false;
+    mesh.setup(std::move(positions), std::move(colors), std::move(indices));
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef __LITEVIZ_PLY_H__
+#define __LITEVIZ_PLY_H__
+
+#include <liteviz/core/common.h>
+#include <liteviz/core/mesh.h>
+
+namespace liteviz {
+
+struct PlyStats {
+    size_t bytes = 0;           // size of the file
+    size_t vertices = 0;
+    size_t faces = 0;
+    double seconds = 0.0;
+    bool binary = false;
+
+    double throughput() const { return seconds > 0.0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0; }
+};
+
+// PLY import. The header is parsed with tinyply, the body is read from a
+// memory mapping directly into the destination arrays: binary files (either
+// byte order) row by row, ASCII files split into line ranges parsed on all
+// cores. Vertex colors may be uchar or float, faces are fan-triangulated.
+struct PlyIO {
+
+static bool load(const std::string& path,
+                 std::vector<vec3f>& positions,
+                 std::vector<vec4f>& colors,
+                 std::vector<GLuint>& indices,
+                 PlyStats* stats = nullptr);
+
+static bool load(const std::string& path, PointCloud& cloud, PlyStats* stats = nullptr);
+
+static bool load(const std::string& path, TriangleMesh& mesh, PlyStats* stats = nullptr);
+
+};
+
+} // namespace liteviz
+
+#endif // __LITEVIZ_PLY_H__
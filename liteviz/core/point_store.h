@@ -0,0 +1,256 @@
+#ifndef __LITEVIZ_POINT_STORE_H__
+#define __LITEVIZ_POINT_STORE_H__
+
+#include <liteviz/core/common.h>
+#include <liteviz/core/shader.h>
+#include <liteviz/core/viewport.h>
+#include <liteviz/core/mesh.h>
+
+#include <set>
+
+namespace liteviz {
+
+// Point cloud addressed by external point IDs, for mirroring a SLAM map as
+// points are created, refined, merged and culled. Every ID owns a slot of the
+// vertex buffer; freed slots go to a free list and are reused lowest first.
+// Changes are collected per frame and sent as one glBufferSubData per run of
+// adjacent changed slots, live slots are drawn as runs with one
+// glMultiDrawArrays. Once the share of free slots passes the compaction
+// threshold, every frame moves a bounded number of points from the top of the
+// buffer into the holes until it is dense again.
+class PointStore: public Mesh{
+public:
+    using Id = uint64_t;
+
+    // insert the point `id`, or overwrite it if it exists
+    void insert(Id id, const vec3f& position, const vec4f& color = COLOR_WHITE){
+        auto it = slots.find(id);
+        if(it != slots.end()){
+            positions[it->second] = position;
+            colors[it->second] = color;
+            mark(it->second);
+            return;
+        }
+
+        uint32_t slot;
+        if(!free_slots.empty()){
+            slot = *free_slots.begin();
+            free_slots.erase(free_slots.begin());
+            positions[slot] = position;
+            colors[slot] = color;
+            ids[slot] = id;
+        }else{
+            slot = positions.size();
+            positions.push_back(position);
+            colors.push_back(color);
+            ids.push_back(id);
+            dirty.push_back(false);
+        }
+        slots.emplace(id, slot);
+        mark(slot);
+        runs_valid = false;
+    }
+
+    // false if `id` is unknown
+    bool update(Id id, const vec3f& position){
+        auto it = slots.find(id);
+        if(it == slots.end())
+            return false;
+        positions[it->second] = position;
+        mark(it->second);
+        return true;
+    }
+
+    bool update(Id id, const vec3f& position, const vec4f& color){
+        auto it = slots.find(id);
+        if(it == slots.end())
+            return false;
+        positions[it->second] = position;
+        colors[it->second] = color;
+        mark(it->second);
+        return true;
+    }
+
+    bool erase(Id id){
+        auto it = slots.find(id);
+        if(it == slots.end())
+            return false;
+        free_slots.insert(it->second);
+        slots.erase(it);
+        trim();
+        runs_valid = false;
+        return true;
+    }
+
+    bool contains(Id id) const {
+        return slots.count(id) > 0;
+    }
+
+    void clear(){
+        clean();
+        slots.clear();
+        ids.clear();
+        dirty.clear();
+        dirty_slots.clear();
+        free_slots.clear();
+        runs_valid = false;
+    }
+
+    // number of live points
+    size_t size() const {
+        return slots.size();
+    }
+
+    // share of the buffer taken by freed slots
+    float getFragmentation() const {
+        return positions.empty() ? 0.0f : float(free_slots.size()) / positions.size();
+    }
+
+    size_t getDrawRuns() const {
+        return firsts.size();
+    }
+
+    // compact above `threshold` fragmentation, moving at most `moves_per_frame` points per frame
+    void setCompaction(float threshold, size_t moves_per_frame = 4096){
+        compact_threshold = threshold;
+        compact_moves = moves_per_frame;
+    }
+
+    void setPointSize(const int size){
+        point_size = size;
+    }
+
+    void draw(Shader* shader, const Viewport& viewport) override {
+
+        compact();
+        if(!runs_valid)
+            buildRuns();
+        if(firsts.empty())
+            return;
+
+        mat4f transform = viewport.getProjectionMatrix() * viewport.getViewMatrix();
+
+        shader->bind(false);
+        shader->set_uniform("ProjMat", transform);
+        shader->set_uniform("Alpha", 1.0f);
+        shader->set_uniform("PointSize", static_cast<float>(point_size));
+        buffer.bind();
+        sync(shader);
+        shader->draw_multi(GL_POINTS, firsts.data(), counts.data(), firsts.size());
+        buffer.unbind();
+        shader->unbind(false);
+    }
+
+private:
+    void mark(uint32_t slot){
+        if(!dirty[slot]){
+            dirty[slot] = true;
+            dirty_slots.push_back(slot);
+        }
+    }
+
+    // drop free slots at the top so the buffer ends with a live point
+    void trim(){
+        while(!free_slots.empty() && *free_slots.rbegin() == positions.size() - 1){
+            free_slots.erase(std::prev(free_slots.end()));
+            positions.pop_back();
+            colors.pop_back();
+            ids.pop_back();
+            dirty.pop_back();
+        }
+    }
+
+    // move the topmost points into the lowest holes
+    void compact(){
+        if(getFragmentation() <= compact_threshold)
+            return;
+        for(size_t moved = 0; moved < compact_moves && !free_slots.empty(); ++moved){
+            uint32_t from = positions.size() - 1;
+            uint32_t to = *free_slots.begin();
+            free_slots.erase(free_slots.begin());
+
+            positions[to] = positions[from];
+            colors[to] = colors[from];
+            ids[to] = ids[from];
+            slots[ids[to]] = to;
+            mark(to);
+
+            free_slots.insert(from);
+            trim();
+        }
+        runs_valid = false;
+    }
+
+    // live slots are the gaps between free ones
+    void buildRuns(){
+        firsts.clear();
+        counts.clear();
+        uint32_t first = 0;
+        for(uint32_t hole : free_slots){
+            if(hole > first){
+                firsts.push_back(first);
+                counts.push_back(hole - first);
+            }
+            first = hole + 1;
+        }
+        if(positions.size() > first){
+            firsts.push_back(first);
+            counts.push_back(positions.size() - first);
+        }
+        runs_valid = true;
+    }
+
+    // full upload after a program change, otherwise the tail beyond the GPU
+    // copy plus one write per run of changed slots; expects `buffer` to be bound
+    void sync(Shader* shader){
+        size_t resident = buffer.vertices();
+        if(buffer.outdated(version, shader->programID())){
+            shader->set_attribute(buffer, "Color", colors);
+            shader->set_attribute(buffer, "Position", positions);
+            resident = positions.size();
+        }else{
+            if(resident < positions.size()){
+                shader->append_attribute(buffer, "Color", colors, resident);
+                shader->append_attribute(buffer, "Position", positions, resident);
+            }
+            resident = std::min(resident, positions.size());
+
+            std::sort(dirty_slots.begin(), dirty_slots.end());
+            for(size_t i = 0; i < dirty_slots.size();){
+                size_t first = dirty_slots[i], last = first;
+                while(++i < dirty_slots.size() && dirty_slots[i] == last + 1)
+                    last = dirty_slots[i];
+                if(first >= resident)
+                    break;
+                last = std::min(last, resident - 1);
+                shader->update_attribute(buffer, "Color", colors, first, last + 1 - first);
+                shader->update_attribute(buffer, "Position", positions, first, last + 1 - first);
+            }
+        }
+        for(uint32_t slot : dirty_slots){
+            if(slot < dirty.size())
+                dirty[slot] = false;
+        }
+        dirty_slots.clear();
+        // the GPU buffer keeps its size when the store shrinks, the tail is simply not drawn
+        buffer.validate(version, shader->programID(), std::max(resident, positions.size()));
+    }
+
+    std::unordered_map<Id, uint32_t> slots;
+    std::vector<Id> ids;                    // owner of every slot
+    std::set<uint32_t> free_slots;
+    std::vector<bool> dirty;
+    std::vector<uint32_t> dirty_slots;
+
+    float compact_threshold = 0.25f;
+    size_t compact_moves = 4096;
+    int point_size = 1;
+
+    bool runs_valid = false;
+    std::vector<GLint> firsts;
+    std::vector<GLsizei> counts;
+};
+
+} // namespace liteviz
+
+#endif // __LITEVIZ_POINT_STORE_H__
@@ -0,0 +1,298 @@
+#ifndef __LITEVIZ_PROFILER_H__
+#define __LITEVIZ_PROFILER_H__
+
+#include <liteviz/core/common.h>
+#include <liteviz/core/shader.h>
+#include <liteviz/core/utils.h>
+
+namespace liteviz {
+
+// CPU and GPU time per named section of a frame. Sections are timed with
+// scopes, which may nest:
+//
+//     profiler.beginFrame();
+//     {
+//         FrameProfiler::Scope scope(profiler, profiler.getSection("points"));
+//         cloud.draw(shader, viewport);
+//     }
+//     profiler.endFrame();
+//
+// GPU times come from GL_TIMESTAMP queries around each scope (unlike
+// GL_TIME_ELAPSED these nest). Query results are read `latency` frames
+// later, when the GPU is long done with them, so profiling never stalls the
+// pipeline; a frame whose queries are still not available then is skipped.
+// Times are summed per section and frame and kept for the last `history`
+// frames. While the trace recorder is on, every scope also goes to the trace
+// timeline, profiling enabled or not. Render thread only.
+class FrameProfiler {
+public:
+    struct Stats {
+        float last = 0.0f;
+        float mean = 0.0f;
+        float p50 = 0.0f;
+        float p95 = 0.0f;
+        float p99 = 0.0f;
+        float max = 0.0f;
+    };
+
+    // ring of the last samples in ms
+    struct History {
+        std::vector<float> samples;
+        size_t next = 0;        // oldest sample once the ring is full
+
+        void push(float value, size_t capacity) {
+            if (samples.size() < capacity) {
+                samples.push_back(value);
+            } else {
+                samples[next] = value;
+                next = (next + 1) % capacity;
+            }
+        }
+
+        // index of the newest sample
+        size_t newest() const {
+            return (next + samples.size() - 1) % samples.size();
+        }
+
+        Stats stats() const {
+            Stats s;
+            if (samples.empty())
+                return s;
+            std::vector<float> sorted = samples;
+            std::sort(sorted.begin(), sorted.end());
+            auto at = [&](float q) { return sorted[std::min(sorted.size() - 1, size_t(q * sorted.size()))]; };
+            s.last = samples[newest()];
+            s.mean = std::accumulate(sorted.begin(), sorted.end(), 0.0f) / sorted.size();
+            s.p50 = at(0.50f);
+            s.p95 = at(0.95f);
+            s.p99 = at(0.99f);
+            s.max = sorted.back();
+            return s;
+        }
+    };
+
+    struct Section {
+        Section(std::string name, const char* trace_name): name(std::move(name)), trace_name(trace_name) {}
+
+        std::string name;
+        const char* trace_name = nullptr;
+        int depth = 0;          // nesting level when last timed
+        History cpu;
+        History gpu;
+    };
+
+    class Scope {
+    public:
+        Scope(FrameProfiler& profiler, size_t section): profiler(profiler) {
+            profiler.begin(section);
+        }
+        ~Scope() {
+            profiler.end();
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        FrameProfiler& profiler;
+    };
+
+    // section 0 is the whole frame
+    explicit FrameProfiler(size_t history = 300, int latency = 4):
+        history(history), frames(std::max(latency, 1)) {
+        getSection("frame");
+    }
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    ~FrameProfiler() {
+        release();
+    }
+
+    // GL queries are deleted, needs the context they were made in
+    void release() {
+        for (auto& frame : frames) {
+            for (auto& query : frame.queries)
+                glDeleteQueries(2, query.ids);
+            frame.queries.clear();
+            frame.used = 0;
+        }
+    }
+
+    // takes effect at the next beginFrame()
+    void setEnabled(bool enabled) {
+        this->enabled = enabled;
+    }
+
+    bool isEnabled() const {
+        return enabled;
+    }
+
+    // id of the section `name`, created on first use
+    size_t getSection(std::string_view name) {
+        auto it = lookup.find(name);
+        if (it != lookup.end())
+            return it->second;
+        std::string key(name);
+        sections.emplace_back(key, trace_recorder().intern(key));
+        accumulated.push_back(Sample());
+        lookup.emplace(std::move(key), sections.size() - 1);
+        return sections.size() - 1;
+    }
+
+    const std::vector<Section>& getSections() const {
+        return sections;
+    }
+
+    // frames whose GPU times were dropped because the queries were late
+    size_t getSkippedFrames() const {
+        return skipped;
+    }
+
+    // frames between issuing GPU queries and reading them
+    size_t getLatency() const {
+        return frames.size();
+    }
+
+    bool hasGpuTimes() const {
+        return gpu_timer > 0;
+    }
+
+    void beginFrame() {
+        active = enabled;
+        tracing = trace_recorder().isEnabled();
+        if (active) {
+            if (gpu_timer < 0) {
+                GLint bits = 0;
+                glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+                gpu_timer = bits > 0 ? 1 : 0;
+            }
+            Frame& frame = frames[current % frames.size()];
+            collect(frame);
+            frame.used = 0;
+        } else {
+            // nothing in flight may be read once profiling is back on
+            for (auto& frame : frames)
+                frame.used = 0;
+        }
+        begin(0);
+    }
+
+    void endFrame() {
+        if (!active && !tracing)
+            return;
+        while (!stack.empty())
+            end();
+        if (active) {
+            for (size_t i = 0; i < sections.size(); ++i) {
+                if (accumulated[i].seen)
+                    sections[i].cpu.push(accumulated[i].ms, history);
+                accumulated[i] = Sample();
+            }
+            ++current;
+        }
+        active = false;
+        tracing = false;
+    }
+
+    void begin(size_t section) {
+        if (!active && !tracing)
+            return;
+        Open open;
+        open.section = section;
+        open.start = std::chrono::high_resolution_clock::now();
+        if (active && gpu_timer > 0) {
+            Frame& frame = frames[current % frames.size()];
+            if (frame.used == frame.queries.size()) {
+                frame.queries.emplace_back();
+                glGenQueries(2, frame.queries.back().ids);
+            }
+            open.query = frame.used++;
+            frame.queries[open.query].section = section;
+            glQueryCounter(frame.queries[open.query].ids[0], GL_TIMESTAMP);
+        }
+        sections[section].depth = int(stack.size());
+        stack.push_back(open);
+    }
+
+    void end() {
+        if (stack.empty())
+            return;
+        Open open = stack.back();
+        stack.pop_back();
+        auto now = std::chrono::high_resolution_clock::now();
+        if (tracing)
+            trace_recorder().record(sections[open.section].trace_name, "frame", open.start, now);
+        if (!active)
+            return;
+        accumulated[open.section].ms += std::chrono::duration<float, std::milli>(now - open.start).count();
+        accumulated[open.section].seen = true;
+        if (gpu_timer > 0)
+            glQueryCounter(frames[current % frames.size()].queries[open.query].ids[1], GL_TIMESTAMP);
+    }
+
+private:
+    struct Query {
+        GLuint ids[2] = {0, 0};     // timestamps at begin and end
+        size_t section = 0;
+    };
+
+    struct Frame {
+        std::vector<Query> queries;
+        size_t used = 0;
+    };
+
+    struct Open {
+        size_t section = 0;
+        size_t query = 0;
+        std::chrono::high_resolution_clock::time_point start;
+    };
+
+    struct Sample {
+        float ms = 0.0f;
+        bool seen = false;
+    };
+
+    // GPU times of a frame issued `latency` frames ago
+    void collect(Frame& frame) {
+        if (frame.used == 0)
+            return;
+        // queries complete in order and the frame scope closes last
+        GLint available = 0;
+        glGetQueryObjectiv(frame.queries[0].ids[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            ++skipped;
+            return;
+        }
+        std::vector<Sample> gpu(sections.size());
+        for (size_t i = 0; i < frame.used; ++i) {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(frame.queries[i].ids[0], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(frame.queries[i].ids[1], GL_QUERY_RESULT, &end);
+            Sample& sample = gpu[frame.queries[i].section];
+            sample.ms += float(double(end - begin) * 1e-6);
+            sample.seen = true;
+        }
+        for (size_t i = 0; i < sections.size(); ++i) {
+            if (gpu[i].seen)
+                sections[i].gpu.push(gpu[i].ms, history);
+        }
+    }
+
+    size_t history;
+    bool enabled = false;
+    bool active = false;            // enabled for the frame in progress
+    bool tracing = false;           // trace recorder on for the frame in progress
+    int gpu_timer = -1;             // timestamp queries supported, -1 before the first check
+    size_t skipped = 0;
+    uint64_t current = 0;
+
+    std::vector<Section> sections;
+    std::map<std::string, size_t, std::less<>> lookup;     // transparent, literals look up without a copy
+    std::vector<Sample> accumulated;    // CPU time per section in the frame in progress
+    std::vector<Open> stack;
+    std::vector<Frame> frames;          // queries per frame in flight
+};
+
+} // namespace liteviz
+
+#endif // __LITEVIZ_PROFILER_H__
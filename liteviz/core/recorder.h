@@ -0,0 +1,347 @@
+#ifndef __LITEVIZ_RECORDER_H__
+#define __LITEVIZ_RECORDER_H__
+
+#include <liteviz/core/common.h>
+#include <liteviz/core/image.h>
+#include <liteviz/core/capture.h>
+
+#include <atomic>
+#include <cstdio>
+
+namespace liteviz {
+
+// Records every frame to disk without holding up the render loop. Frames are
+// read back asynchronously through a FrameCapture, copied into a fixed pool of
+// Images and encoded by worker threads. When the workers fall behind and the
+// pool runs dry, frames are dropped and counted instead of waiting:
+//
+//     recorder.start("demo", FrameRecorder::Format::Y4M);
+//     // every frame, after drawing
+//     recorder.capture(width, height);
+//     ...
+//     recorder.stop();
+//
+// PNG, QOI and RAW write one file per frame (frame-000000.png, raw files are
+// RGBA rows top first), Y4M writes a single 4:4:4 stream playable by ffmpeg/mpv.
+// Frames are numbered in the order they are kept, drops leave no gaps.
+// capture() and stop() read back and need the render thread's context.
+class FrameRecorder {
+public:
+    enum class Format { PNG, RAW, Y4M, QOI };
+
+    FrameRecorder(int workers = 2, size_t pool_size = 8): workers(std::max(workers, 1)), pool_size(pool_size) {}
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    ~FrameRecorder() {
+        stop();
+    }
+
+    // start writing into `dir`, created if missing
+    bool start(const std::string& dir, Format format, int fps = 30) {
+        if (recording)
+            stop();
+
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        if (ec) {
+            std::cerr << "Failed to create recording directory " << dir << ": " << ec.message() << std::endl;
+            return false;
+        }
+        this->dir = dir;
+        this->format = format;
+        this->fps = fps;
+        if (format == Format::Y4M) {
+            stream = std::fopen((dir + "/video.y4m").c_str(), "wb");
+            if (!stream) {
+                std::cerr << "Failed to open " << dir << "/video.y4m" << std::endl;
+                return false;
+            }
+        }
+
+        pool.clear();
+        for (size_t i = 0; i < pool_size; ++i)
+            pool.push_back(std::make_unique<Image>());
+        stream_width = stream_height = 0;
+        next_frame = 0;
+        next_write = 0;
+        recorded = 0;
+        dropped = 0;
+        failed = false;
+        done = false;
+        for (int i = 0; i < workers; ++i)
+            threads.emplace_back(&FrameRecorder::work, this);
+        recording = true;
+        return true;
+    }
+
+    // finish the frames still being read back or encoded and close the output
+    void stop() {
+        if (!recording)
+            return;
+        recording = false;
+
+        collect(true);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        queued.notify_all();
+        for (auto& thread : threads)
+            thread.join();
+        threads.clear();
+        readback.release();
+
+        if (stream) {
+            std::fclose(stream);
+            stream = nullptr;
+        }
+        if (failed)
+            std::cerr << "Recording to " << dir << " had write errors" << std::endl;
+    }
+
+    // render thread, once per frame: read back the current read framebuffer
+    // and hand earlier frames whose readback is done to the workers
+    void capture(int width, int height) {
+        if (!recording)
+            return;
+        collect(false);
+        if (!readback.request(width, height))
+            ++dropped;
+    }
+
+    bool isRecording() const {
+        return recording;
+    }
+
+    size_t getRecorded() const {
+        return recorded;
+    }
+
+    size_t getDropped() const {
+        return dropped;
+    }
+
+    const std::string& getDirectory() const {
+        return dir;
+    }
+
+private:
+    struct Job {
+        uint64_t frame;
+        std::unique_ptr<Image> image;
+    };
+
+    // move finished readbacks into pooled images, `wait` blocks for all of them
+    void collect(bool wait) {
+        while (readback.pending() > 0) {
+            std::unique_ptr<Image> image;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (wait)
+                    returned.wait(lock, [this]{ return !pool.empty(); });
+                if (!pool.empty()) {
+                    image = std::move(pool.back());
+                    pool.pop_back();
+                }
+            }
+            // the ring slot has to be freed either way, a frame without an image is dropped
+            Image& target = image ? *image : scratch;
+            bool ready = wait ? readback.wait(target) : readback.collect(target);
+            if (!ready || !image || !accepts(target)) {
+                if (image) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    pool.push_back(std::move(image));
+                }
+                if (!ready)
+                    return;
+                ++dropped;
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobs.push_back({next_frame++, std::move(image)});
+            }
+            queued.notify_one();
+        }
+    }
+
+    // a Y4M stream keeps the size of its first frame
+    bool accepts(const Image& image) {
+        if (format != Format::Y4M)
+            return true;
+        if (stream_width == 0) {
+            stream_width = image.width;
+            stream_height = image.height;
+            std::fprintf(stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", stream_width, stream_height, fps);
+        }
+        return image.width == stream_width && image.height == stream_height;
+    }
+
+    void work() {
+        std::vector<uint8_t> planes;
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                queued.wait(lock, [this]{ return done || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            bool ok = true;
+            char name[32];
+            switch (format) {
+            case Format::PNG:
+                std::snprintf(name, sizeof(name), "/frame-%06llu.png", (unsigned long long)job.frame);
+                // frames are already spread over the workers, one encoder thread each
+                ok = ImageIO::save_png_fast(dir + name, *job.image, 1);
+                break;
+            case Format::QOI:
+                std::snprintf(name, sizeof(name), "/frame-%06llu.qoi", (unsigned long long)job.frame);
+                ok = ImageIO::save_qoi(dir + name, *job.image);
+                break;
+            case Format::RAW: {
+                std::snprintf(name, sizeof(name), "/frame-%06llu.raw", (unsigned long long)job.frame);
+                std::ofstream file(dir + name, std::ios::binary);
+                file.write(reinterpret_cast<const char*>(job.image->ptr()), job.image->data.size());
+                ok = bool(file);
+                break;
+            }
+            case Format::Y4M:
+                toYUV444(*job.image, planes);
+                ok = append(job.frame, planes);
+                break;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (ok)
+                    ++recorded;
+                else
+                    failed = true;
+                pool.push_back(std::move(job.image));
+            }
+            returned.notify_one();
+        }
+    }
+
+    // frames are converted in parallel but appended to the stream in order
+    bool append(uint64_t frame, const std::vector<uint8_t>& planes) {
+        std::unique_lock<std::mutex> lock(mutex);
+        written.wait(lock, [&]{ return next_write == frame; });
+        lock.unlock();
+        bool ok = std::fputs("FRAME\n", stream) >= 0 &&
+                  std::fwrite(planes.data(), 1, planes.size(), stream) == planes.size();
+        lock.lock();
+        ++next_write;
+        written.notify_all();
+        return ok;
+    }
+
+    // BT.601 limited range, alpha is dropped
+    static void toYUV444(const Image& image, std::vector<uint8_t>& planes) {
+        size_t n = size_t(image.width) * image.height;
+        planes.resize(n * 3);
+        uint8_t* y = planes.data();
+        uint8_t* u = y + n;
+        uint8_t* v = u + n;
+        const uint8_t* p = image.ptr();
+        for (size_t i = 0; i < n; ++i, p += image.channels) {
+            int r = p[0], g = p[1], b = p[2];
+            y[i] = uint8_t((( 66 * r + 129 * g +  25 * b + 128) >> 8) + 16);
+            u[i] = uint8_t(((-38 * r -  74 * g + 112 * b + 128) >> 8) + 128);
+            v[i] = uint8_t(((112 * r -  94 * g -  18 * b + 128) >> 8) + 128);
+        }
+    }
+
+    int workers;
+    size_t pool_size;
+
+    std::string dir;
+    Format format = Format::PNG;
+    int fps = 30;
+    std::FILE* stream = nullptr;
+    int stream_width = 0;
+    int stream_height = 0;
+
+    FrameCapture readback;
+    Image scratch;                                  // target for readbacks that are dropped
+
+    std::mutex mutex;                               // guards pool, jobs, done, next_write and failed
+    std::condition_variable queued;
+    std::condition_variable written;
+    std::condition_variable returned;
+    std::vector<std::unique_ptr<Image>> pool;       // images free for readbacks
+    std::deque<Job> jobs;
+    std::vector<std::thread> threads;
+    bool done = false;
+    bool failed = false;
+    uint64_t next_frame = 0;                        // render thread only
+    uint64_t next_write = 0;
+
+    std::atomic<bool> recording{false};
+    std::atomic<size_t> recorded{0};
+    std::atomic<size_t> dropped{0};
+};
+
+// Writes single images such as snapshots as PNG on a background thread, so
+// the encode never runs on the render thread. Started by the first write(),
+// the destructor finishes the queued images.
+class ImageWriter {
+public:
+    ImageWriter() = default;
+
+    ImageWriter(const ImageWriter&) = delete;
+    ImageWriter& operator=(const ImageWriter&) = delete;
+
+    ~ImageWriter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        queued.notify_all();
+        if (thread.joinable())
+            thread.join();
+    }
+
+    void write(std::string path, Image image) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.emplace_back(std::move(path), std::move(image));
+        }
+        if (!thread.joinable())
+            thread = std::thread(&ImageWriter::work, this);
+        queued.notify_one();
+    }
+
+private:
+    void work() {
+        while (true) {
+            std::pair<std::string, Image> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                queued.wait(lock, [this]{ return done || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            if (!ImageIO::save_png_fast(job.first, job.second))
+                std::cerr << "Failed to write " << job.first << std::endl;
+        }
+    }
+
+    std::mutex mutex;                               // guards jobs and done
+    std::condition_variable queued;
+    std::deque<std::pair<std::string, Image>> jobs;
+    std::thread thread;                             // render thread only
+    bool done = false;
+};
+
+} // namespace liteviz
+
+#endif // __LITEVIZ_RECORDER_H__
@@ -0,0 +1,399 @@
+#ifndef __LITEVIZ_SCENE_FILE_H__
+#define __LITEVIZ_SCENE_FILE_H__
+
+#include <liteviz/core/common.h>
+#include <liteviz/core/shader.h>
+#include <liteviz/core/viewport.h>
+#include <liteviz/core/mesh.h>
+#include <liteviz/core/octree.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace liteviz {
+
+// Native scene container. Everything is little-endian and laid out exactly
+// as it is uploaded, so a mapped file is handed to glBufferData as is:
+//
+//   SceneHeader                         at offset 0
+//   per block, each array 64-byte aligned:
+//     vec3f    positions[vertex_count]
+//     vec4f    colors[vertex_count]
+//     uint32_t indices[index_count]     optional
+//     SceneChunk chunks[chunk_count]    optional, octree LOD nodes whose
+//                                       ranges index into the vertex arrays
+//   SceneBlock blocks[block_count]      at SceneHeader::blocks_offset
+
+struct SceneHeader {
+    char magic[8] = {'L', 'V', 'S', 'C', 'E', 'N', 'E', '1'};
+    uint32_t version = 1;
+    uint32_t byte_order = 0x01020304;   // reads back as 0x04030201 on a big-endian host
+    uint64_t block_count = 0;
+    uint64_t blocks_offset = 0;
+    uint64_t file_size = 0;
+    uint8_t reserved[24] = {};
+};
+
+struct SceneBlock {
+    char name[64] = {};
+    uint32_t primitive = GL_POINTS;     // GL_POINTS, GL_LINES or GL_TRIANGLES
+    uint32_t flags = 0;
+    uint64_t vertex_count = 0;
+    uint64_t index_count = 0;
+    uint64_t chunk_count = 0;
+    uint64_t positions_offset = 0;
+    uint64_t colors_offset = 0;
+    uint64_t indices_offset = 0;
+    uint64_t chunks_offset = 0;
+};
+
+struct SceneChunk {
+    float center[3];
+    float half_size;
+    float spacing;
+    uint32_t level;
+    uint32_t first;
+    uint32_t count;
+    int32_t children[8];
+
+    OctreeNode node() const {
+        OctreeNode node;
+        node.center = vec3f(center[0], center[1], center[2]);
+        node.half_size = half_size;
+        node.spacing = spacing;
+        node.level = level;
+        node.first = first;
+        node.count = node.total = count;
+        std::copy(children, children + 8, node.children.begin());
+        return node;
+    }
+};
+
+static_assert(sizeof(SceneHeader) == 64, "SceneHeader layout");
+static_assert(sizeof(SceneBlock) == 128, "SceneBlock layout");
+static_assert(sizeof(SceneChunk) == 64, "SceneChunk layout");
+
+// Collects blocks and writes them in one pass. add() only keeps pointers, the
+// data has to stay alive until write(); addLOD() keeps its own reordered copy.
+class SceneWriter {
+public:
+    void add(const std::string& name, const Mesh& mesh, GLenum primitive){
+        add(name, mesh.getPositions(), mesh.getColors(), mesh.getIndices(), primitive);
+    }
+
+    void add(const std::string& name,
+             const std::vector<vec3f>& positions,
+             const std::vector<vec4f>& colors,
+             const std::vector<GLuint>& indices,
+             GLenum primitive){
+        Pending block;
+        block.record = makeRecord(name, primitive, positions.size(), indices.size());
+        block.positions = positions.data();
+        block.colors = colors.size() == positions.size() ? colors.data() : nullptr;
+        block.indices = indices.data();
+        blocks.push_back(std::move(block));
+    }
+
+    // point cloud stored in PointOctree node order together with the node table
+    void addLOD(const std::string& name,
+                const std::vector<vec3f>& positions,
+                const std::vector<vec4f>& colors,
+                size_t leaf_size = 65536){
+        PointOctree octree;
+        octree.build(positions, leaf_size);
+
+        Pending block;
+        block.record = makeRecord(name, GL_POINTS, positions.size(), 0);
+        block.owned_positions.resize(positions.size());
+        block.owned_colors.resize(positions.size(), COLOR_WHITE);
+        for(size_t i = 0; i < octree.order.size(); ++i){
+            block.owned_positions[i] = positions[octree.order[i]];
+            if(colors.size() == positions.size())
+                block.owned_colors[i] = colors[octree.order[i]];
+        }
+        for(const auto& node : octree.nodes){
+            SceneChunk chunk;
+            std::copy(node.center.data(), node.center.data() + 3, chunk.center);
+            chunk.half_size = node.half_size;
+            chunk.spacing = node.spacing;
+            chunk.level = node.level;
+            chunk.first = node.first;
+            chunk.count = node.count;
+            std::copy(node.children.begin(), node.children.end(), chunk.children);
+            block.chunks.push_back(chunk);
+        }
+        block.record.chunk_count = block.chunks.size();
+        block.positions = block.owned_positions.data();
+        block.colors = block.owned_colors.data();
+        blocks.push_back(std::move(block));
+    }
+
+    bool write(const std::string& path){
+        std::ofstream file(path, std::ios::binary);
+        if(!file.is_open()){
+            std::cerr << "Failed to open file for writing: " << path << std::endl;
+            return false;
+        }
+
+        SceneHeader header;
+        uint64_t offset = sizeof(SceneHeader);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        auto put = [&](const void* data, uint64_t bytes){
+            uint64_t aligned = align(offset);
+            static const char zeros[ALIGNMENT] = {};
+            file.write(zeros, aligned - offset);
+            file.write(static_cast<const char*>(data), bytes);
+            offset = aligned + bytes;
+            return aligned;
+        };
+
+        std::vector<SceneBlock> records;
+        for(auto& block : blocks){
+            SceneBlock record = block.record;
+            record.positions_offset = put(block.positions, sizeof(vec3f) * record.vertex_count);
+            if(block.colors){
+                record.colors_offset = put(block.colors, sizeof(vec4f) * record.vertex_count);
+            }else{
+                std::vector<vec4f> white(record.vertex_count, COLOR_WHITE);
+                record.colors_offset = put(white.data(), sizeof(vec4f) * record.vertex_count);
+            }
+            if(record.index_count > 0)
+                record.indices_offset = put(block.indices, sizeof(GLuint) * record.index_count);
+            if(record.chunk_count > 0)
+                record.chunks_offset = put(block.chunks.data(), sizeof(SceneChunk) * record.chunk_count);
+            records.push_back(record);
+        }
+
+        header.block_count = records.size();
+        header.blocks_offset = put(records.data(), sizeof(SceneBlock) * records.size());
+        header.file_size = offset;
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        blocks.clear();
+        return file.good();
+    }
+
+private:
+    static constexpr uint64_t ALIGNMENT = 64;
+
+    struct Pending {
+        SceneBlock record;
+        const vec3f* positions = nullptr;
+        const vec4f* colors = nullptr;
+        const GLuint* indices = nullptr;
+        std::vector<vec3f> owned_positions;
+        std::vector<vec4f> owned_colors;
+        std::vector<SceneChunk> chunks;
+    };
+
+    static uint64_t align(uint64_t offset){
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    static SceneBlock makeRecord(const std::string& name, GLenum primitive, size_t vertices, size_t indices){
+        SceneBlock record;
+        std::strncpy(record.name, name.c_str(), sizeof(record.name) - 1);
+        record.primitive = primitive;
+        record.vertex_count = vertices;
+        record.index_count = indices;
+        return record;
+    }
+
+    std::vector<Pending> blocks;
+};
+
+// Read-only memory mapping of a scene container. Opening validates the header,
+// the block table and the index and chunk arrays; vertex data is paged in when
+// it is first touched.
+class SceneFile {
+public:
+    SceneFile() = default;
+    SceneFile(const SceneFile&) = delete;
+    SceneFile& operator=(const SceneFile&) = delete;
+
+    ~SceneFile(){
+        close();
+    }
+
+    bool open(const std::string& path){
+        close();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0){
+            std::cerr << "Failed to open file: " << path << std::endl;
+            return false;
+        }
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SceneHeader)){
+            std::cerr << "Not a scene file: " << path << std::endl;
+            ::close(fd);
+            return false;
+        }
+        void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(ptr == MAP_FAILED){
+            std::cerr << "Failed to map file: " << path << std::endl;
+            return false;
+        }
+        base = static_cast<const uint8_t*>(ptr);
+        length = st.st_size;
+
+        if(!validate()){
+            std::cerr << "Invalid scene file: " << path << std::endl;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close(){
+        if(base)
+            munmap(const_cast<uint8_t*>(base), length);
+        base = nullptr;
+        length = 0;
+    }
+
+    bool isOpen() const {
+        return base != nullptr;
+    }
+
+    size_t blockCount() const {
+        return base ? header().block_count : 0;
+    }
+
+    const SceneBlock& block(size_t index) const {
+        return reinterpret_cast<const SceneBlock*>(base + header().blocks_offset)[index];
+    }
+
+    // index of the block called `name`, -1 if there is none
+    int find(const std::string& name) const {
+        for(size_t i = 0; i < blockCount(); ++i){
+            // the name field is not NUL terminated in a file we didn't write
+            const char* field = block(i).name;
+            if(name == std::string(field, strnlen(field, sizeof(block(i).name))))
+                return i;
+        }
+        return -1;
+    }
+
+    const vec3f* positions(size_t index) const {
+        return reinterpret_cast<const vec3f*>(base + block(index).positions_offset);
+    }
+
+    const vec4f* colors(size_t index) const {
+        return reinterpret_cast<const vec4f*>(base + block(index).colors_offset);
+    }
+
+    const GLuint* indices(size_t index) const {
+        return block(index).index_count ? reinterpret_cast<const GLuint*>(base + block(index).indices_offset) : nullptr;
+    }
+
+    const SceneChunk* chunks(size_t index) const {
+        return block(index).chunk_count ? reinterpret_cast<const SceneChunk*>(base + block(index).chunks_offset) : nullptr;
+    }
+
+private:
+    const SceneHeader& header() const {
+        return *reinterpret_cast<const SceneHeader*>(base);
+    }
+
+    bool validate() const {
+        const SceneHeader& h = header();
+        if(std::memcmp(h.magic, SceneHeader().magic, sizeof(h.magic)) != 0)
+            return false;
+        if(h.version != SceneHeader().version || h.byte_order != SceneHeader().byte_order)
+            return false;
+        // `count` items of T at `offset`, aligned for the casts in the accessors and
+        // without overflowing on hostile counts
+        auto inside = [&](auto* type, uint64_t offset, uint64_t count){
+            using T = std::remove_pointer_t<decltype(type)>;
+            return offset % alignof(T) == 0 && offset <= length && count <= (length - offset) / sizeof(T);
+        };
+        if(h.file_size > length || !inside((SceneBlock*)nullptr, h.blocks_offset, h.block_count))
+            return false;
+        for(size_t i = 0; i < h.block_count; ++i){
+            const SceneBlock& b = block(i);
+            if(!inside((vec3f*)nullptr, b.positions_offset, b.vertex_count) ||
+               !inside((vec4f*)nullptr, b.colors_offset, b.vertex_count) ||
+               !inside((GLuint*)nullptr, b.indices_offset, b.index_count) ||
+               !inside((SceneChunk*)nullptr, b.chunks_offset, b.chunk_count))
+                return false;
+            // GL would read past the vertex arrays through a bad index or chunk range
+            const GLuint* block_indices = indices(i);
+            for(uint64_t k = 0; k < b.index_count; ++k){
+                if(block_indices[k] >= b.vertex_count)
+                    return false;
+            }
+            const SceneChunk* block_chunks = chunks(i);
+            for(uint64_t k = 0; k < b.chunk_count; ++k){
+                const SceneChunk& chunk = block_chunks[k];
+                if(chunk.first > b.vertex_count || chunk.count > b.vertex_count - chunk.first)
+                    return false;
+                // SceneWriter stores children after their parent, anything else
+                // could be a cycle that the LOD traversal would follow forever
+                for(int32_t child : chunk.children){
+                    if(child >= 0 && (uint64_t(child) <= k || uint64_t(child) >= b.chunk_count))
+                        return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    const uint8_t* base = nullptr;
+    size_t length = 0;
+};
+
+// Mesh drawn straight from a block of a mapped SceneFile. The first draw hands
+// the mapped arrays to glBufferData, nothing is parsed or copied on the CPU.
+class SceneMesh: public Mesh {
+public:
+    SceneMesh(std::shared_ptr<const SceneFile> file, size_t block): file(file), index(block) {}
+
+    void setPointSize(const int size){
+        point_size = size;
+    }
+
+    std::shared_ptr<Mesh> clone() const override {
+        return std::make_shared<SceneMesh>(*this);
+    }
+
+    void draw(Shader* shader, const Viewport& viewport) override {
+
+        const SceneBlock& block = file->block(index);
+        mat4f transform = viewport.getProjectionMatrix() * viewport.getViewMatrix();
+
+        shader->bind(false);
+        shader->set_uniform("ProjMat", transform);
+        shader->set_uniform("Alpha", 1.0f);
+        if(block.primitive == GL_POINTS)
+            shader->set_uniform("PointSize", static_cast<float>(point_size));
+        buffer.bind();
+        if(buffer.outdated(version, shader->programID())){
+            shader->set_attribute(buffer, "Color", file->colors(index), block.vertex_count);
+            shader->set_attribute(buffer, "Position", file->positions(index), block.vertex_count);
+            if(block.index_count > 0)
+                buffer.set_indices(file->indices(index), block.index_count);
+            buffer.validate(version, shader->programID(), block.vertex_count, block.index_count);
+        }
+        if(block.index_count > 0)
+            shader->draw_indexed(block.primitive, 0, block.index_count, buffer.index_type());
+        else
+            shader->draw(block.primitive, 0, block.vertex_count);
+        buffer.unbind();
+        shader->unbind(false);
+    }
+
+private:
+    std::shared_ptr<const SceneFile> file;
+    size_t index;
+    int point_size = 1;
+};
+
+} // namespace liteviz
+
+#endif // __LITEVIZ_SCENE_FILE_H__
@@ -2,12 +2,97 @@
 #define __LITEVIZ_SHADER_H__
 
 #include <liteviz/core/common.h>
+#include <liteviz/core/utils.h>
+#include <string_view>
 #include <glad/glad.h>  
 #include <GLFW/glfw3.h>
 
 
 namespace liteviz {
 
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+// Resolves GL entry points newer than the 4.3 core profile glad is generated
+// for. Defaults to GLFW, contexts created some other way swap in their own.
+inline GLADloadproc& gl_proc_loader() {
+    static GLADloadproc loader = (GLADloadproc)glfwGetProcAddress;
+    return loader;
+}
+
+// GL work issued from the calling thread, counted by Shader, VertexBuffer,
+// PoseBuffer and ImageTexture. The counters only ever grow; take the
+// difference around the code of interest, e.g. a frame or one renderer.
+struct GLCounters {
+    size_t draw_calls = 0;
+    size_t primitives = 0;          // points, lines or triangles, all instances
+    size_t bytes_uploaded = 0;      // buffer and texture data sent to the GPU
+    size_t program_binds = 0;
+    size_t vao_binds = 0;
+    size_t uniform_updates = 0;
+
+    GLCounters& operator+=(const GLCounters& other) {
+        draw_calls += other.draw_calls;
+        primitives += other.primitives;
+        bytes_uploaded += other.bytes_uploaded;
+        program_binds += other.program_binds;
+        vao_binds += other.vao_binds;
+        uniform_updates += other.uniform_updates;
+        return *this;
+    }
+
+    GLCounters operator-(const GLCounters& other) const {
+        GLCounters d;
+        d.draw_calls = draw_calls - other.draw_calls;
+        d.primitives = primitives - other.primitives;
+        d.bytes_uploaded = bytes_uploaded - other.bytes_uploaded;
+        d.program_binds = program_binds - other.program_binds;
+        d.vao_binds = vao_binds - other.vao_binds;
+        d.uniform_updates = uniform_updates - other.uniform_updates;
+        return d;
+    }
+};
+
+inline GLCounters& gl_counters() {
+    thread_local GLCounters counters;
+    return counters;
+}
+
+// primitives assembled from `count` vertices
+inline size_t gl_primitive_count(GLenum mode, size_t count) {
+    switch (mode) {
+        case GL_LINES:          return count / 2;
+        case GL_LINE_STRIP:     return count > 1 ? count - 1 : 0;
+        case GL_TRIANGLES:      return count / 3;
+        case GL_TRIANGLE_STRIP:
+        case GL_TRIANGLE_FAN:   return count > 2 ? count - 2 : 0;
+        default:                return count;   // points, line loops
+    }
+}
+
+// bytes per pixel of client pixel data
+inline size_t gl_pixel_size(GLenum format, GLenum type) {
+    size_t channels = 4;
+    switch (format) {
+        case GL_RED: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: channels = 1; break;
+        case GL_RG: case GL_RG_INTEGER: channels = 2; break;
+        case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: channels = 3; break;
+        default: break;
+    }
+    switch (type) {
+        case GL_BYTE: case GL_UNSIGNED_BYTE: return channels;
+        case GL_SHORT: case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT: return channels * 2;
+        default: return channels * 4;
+    }
+}
+
+// Doubles as the `normalized` flag of glVertexAttribPointer: integer
+// attributes reach the shader as fixed point in [0, 1] ([-1, 1] if signed),
+// which is what RGBA8 colors and quantized positions want.
 template <typename E> inline GLenum is_type_integral() {
     return GL_FALSE;
 }
@@ -71,6 +156,587 @@ template <> inline GLenum get_type_enum<GLfloat>() {
 }
 
 
+// GPU-side storage for one piece of geometry: a vertex array object together
+// with the attribute and index buffers it references. Meshes keep one of these
+// per primitive so that unchanged data stays resident between frames and is
+// only re-uploaded when its version moves.
+class VertexBuffer {
+public:
+    VertexBuffer() = default;
+
+    // GL objects are never shared, a copy starts empty and uploads on first use
+    VertexBuffer(const VertexBuffer&) {}
+
+    VertexBuffer& operator=(const VertexBuffer& other) {
+        if (this != &other)
+            release();
+        return *this;
+    }
+
+    ~VertexBuffer() {
+        release();
+    }
+
+    // true if the buffer does not hold `version` of the data laid out for `program`
+    bool outdated(uint64_t version, GLuint program) const {
+        return vertex_array == 0 || uploaded_version != version || uploaded_program != program;
+    }
+
+    void validate(uint64_t version, GLuint program, size_t vertices = 0, size_t indices = 0) {
+        uploaded_version = version;
+        uploaded_program = program;
+        uploaded_vertices = vertices;
+        uploaded_indices = indices;
+    }
+
+    // number of vertices/indices already resident, appends start from here
+    size_t vertices() const {
+        return uploaded_vertices;
+    }
+
+    size_t indices() const {
+        return uploaded_indices;
+    }
+
+    void bind() {
+        if (vertex_array == 0)
+            glGenVertexArrays(1, &vertex_array);
+        glBindVertexArray(vertex_array);
+        ++gl_counters().vao_binds;
+    }
+
+    void unbind() {
+        glBindVertexArray(0);
+    }
+
+    // expects the buffer to be bound
+    template <typename E, int N>
+    void set_attribute(GLint attrib, const std::vector<Eigen::Matrix<E, N, 1>> &data) {
+        set_attribute(attrib, data.data(), data.size());
+    }
+
+    // same from `count` elements in memory the caller owns, e.g. a mapped file
+    template <typename E, int N>
+    void set_attribute(GLint attrib, const Eigen::Matrix<E, N, 1> *data, size_t count) {
+        LITEVIZ_TRACE_SCOPE("upload", "gl");
+        Storage& storage = attribute_buffers[attrib];
+        if (storage.buffer == 0)
+            glGenBuffers(1, &storage.buffer);
+        storage.capacity = sizeof(E) * N * count;
+        glBindBuffer(GL_ARRAY_BUFFER, storage.buffer);
+        glBufferData(GL_ARRAY_BUFFER, storage.capacity, data, GL_STATIC_DRAW);
+        gl_counters().bytes_uploaded += storage.capacity;
+        glEnableVertexAttribArray(attrib);
+        glVertexAttribPointer(attrib, N, get_type_enum<E>(), is_type_integral<E>(), 0, nullptr);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // upload only data[first, end) behind what is already resident, expects the buffer to be bound
+    template <typename E, int N>
+    void append_attribute(GLint attrib, const std::vector<Eigen::Matrix<E, N, 1>> &data, size_t first) {
+        if (first >= data.size())
+            return;
+        LITEVIZ_TRACE_SCOPE("upload", "gl");
+        constexpr size_t stride = sizeof(E) * N;
+        Storage& storage = attribute_buffers[attrib];
+        if (write_tail(GL_ARRAY_BUFFER, storage, data[first].data(), stride * first, stride * (data.size() - first))) {
+            glBindBuffer(GL_ARRAY_BUFFER, storage.buffer);
+            glEnableVertexAttribArray(attrib);
+            glVertexAttribPointer(attrib, N, get_type_enum<E>(), is_type_integral<E>(), 0, nullptr);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // overwrite data[first, first + count) of an attribute that is already
+    // resident, expects the buffer to be bound
+    template <typename E, int N>
+    void update_attribute(GLint attrib, const std::vector<Eigen::Matrix<E, N, 1>> &data, size_t first, size_t count) {
+        LITEVIZ_TRACE_SCOPE("upload", "gl");
+        constexpr size_t stride = sizeof(E) * N;
+        glBindBuffer(GL_ARRAY_BUFFER, attribute_buffers.at(attrib).buffer);
+        glBufferSubData(GL_ARRAY_BUFFER, stride * first, stride * count, data[first].data());
+        gl_counters().bytes_uploaded += stride * count;
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // integer counterparts for `in int/uint` shader inputs, read with
+    // glVertexAttribIPointer instead of being converted to float
+    template <typename E>
+    void set_integer_attribute(GLint attrib, const std::vector<E> &data) {
+        LITEVIZ_TRACE_SCOPE("upload", "gl");
+        Storage& storage = attribute_buffers[attrib];
+        if (storage.buffer == 0)
+            glGenBuffers(1, &storage.buffer);
+        storage.capacity = sizeof(E) * data.size();
+        glBindBuffer(GL_ARRAY_BUFFER, storage.buffer);
+        glBufferData(GL_ARRAY_BUFFER, storage.capacity, data.data(), GL_STATIC_DRAW);
+        gl_counters().bytes_uploaded += storage.capacity;
+        glEnableVertexAttribArray(attrib);
+        glVertexAttribIPointer(attrib, 1, get_type_enum<E>(), 0, nullptr);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    template <typename E>
+    void append_integer_attribute(GLint attrib, const std::vector<E> &data, size_t first) {
+        if (first >= data.size())
+            return;
+        LITEVIZ_TRACE_SCOPE("upload", "gl");
+        Storage& storage = attribute_buffers[attrib];
+        if (write_tail(GL_ARRAY_BUFFER, storage, &data[first], sizeof(E) * first, sizeof(E) * (data.size() - first))) {
+            glBindBuffer(GL_ARRAY_BUFFER, storage.buffer);
+            glEnableVertexAttribArray(attrib);
+            glVertexAttribIPointer(attrib, 1, get_type_enum<E>(), 0, nullptr);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // expects the buffer to be bound. Indices that all fit are stored as
+    // 16 bits, draws have to pass index_type() along
+    void set_indices(const std::vector<unsigned int> &indices) {
+        set_indices(indices.data(), indices.size());
+    }
+
+    void set_indices(const unsigned int *indices, size_t count) {
+        LITEVIZ_TRACE_SCOPE("upload", "gl");
+        if (index_storage.buffer == 0)
+            glGenBuffers(1, &index_storage.buffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_storage.buffer);
+        if (fits_short(indices, count)) {
+            index_storage_type = GL_UNSIGNED_SHORT;
+            narrow(indices, count);
+            index_storage.capacity = sizeof(GLushort) * count;
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_storage.capacity, short_indices.data(), GL_STATIC_DRAW);
+            gl_counters().bytes_uploaded += index_storage.capacity;
+        } else {
+            index_storage_type = GL_UNSIGNED_INT;
+            index_storage.capacity = sizeof(GLuint) * count;
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_storage.capacity, indices, GL_STATIC_DRAW);
+            gl_counters().bytes_uploaded += index_storage.capacity;
+        }
+    }
+
+    // expects the buffer to be bound. A tail that no longer fits 16 bits
+    // widens the whole buffer to 32 bits
+    void append_indices(const std::vector<unsigned int> &indices, size_t first) {
+        if (first >= indices.size())
+            return;
+        LITEVIZ_TRACE_SCOPE("upload", "gl");
+        const unsigned int* tail = &indices[first];
+        size_t count = indices.size() - first;
+        if (first == 0 || (index_storage_type == GL_UNSIGNED_SHORT && !fits_short(tail, count))) {
+            set_indices(indices);
+            return;
+        }
+        if (index_storage_type == GL_UNSIGNED_SHORT) {
+            narrow(tail, count);
+            write_tail(GL_ELEMENT_ARRAY_BUFFER, index_storage, short_indices.data(),
+                sizeof(GLushort) * first, sizeof(GLushort) * count);
+        } else {
+            write_tail(GL_ELEMENT_ARRAY_BUFFER, index_storage, tail,
+                sizeof(GLuint) * first, sizeof(GLuint) * count);
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_storage.buffer);
+    }
+
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, whatever the indices were stored as
+    GLenum index_type() const {
+        return index_storage_type;
+    }
+
+    void release() {
+        for (auto& [attrib, storage] : attribute_buffers) {
+            glDeleteBuffers(1, &storage.buffer);
+        }
+        attribute_buffers.clear();
+        if (index_storage.buffer != 0)
+            glDeleteBuffers(1, &index_storage.buffer);
+        if (vertex_array != 0)
+            glDeleteVertexArrays(1, &vertex_array);
+        index_storage = Storage();
+        index_storage_type = GL_UNSIGNED_INT;
+        vertex_array = 0;
+        uploaded_version = 0;
+        uploaded_program = 0;
+        uploaded_vertices = 0;
+        uploaded_indices = 0;
+    }
+
+private:
+    struct Storage {
+        GLuint buffer = 0;
+        size_t capacity = 0;    // bytes allocated on the GPU
+    };
+
+    // Write `bytes` at `offset`. If that overruns the allocation the buffer is
+    // replaced by one of at least twice the size and the first `offset` bytes
+    // are copied over on the GPU, so a long series of appends costs amortized
+    // O(new data). Returns true if the buffer object changed.
+    static bool write_tail(GLenum target, Storage& storage, const void* data, size_t offset, size_t bytes) {
+        bool grown = false;
+        if (storage.buffer == 0 || offset + bytes > storage.capacity) {
+            size_t capacity = std::max(offset + bytes, storage.capacity * 2);
+            GLuint buffer;
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
+            if (storage.buffer != 0) {
+                if (offset > 0) {
+                    glBindBuffer(GL_COPY_READ_BUFFER, storage.buffer);
+                    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, offset);
+                    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+                }
+                glDeleteBuffers(1, &storage.buffer);
+            }
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            storage.buffer = buffer;
+            storage.capacity = capacity;
+            grown = true;
+        }
+        glBindBuffer(target, storage.buffer);
+        glBufferSubData(target, offset, bytes, data);
+        gl_counters().bytes_uploaded += bytes;
+        return grown;
+    }
+
+    static bool fits_short(const unsigned int *indices, size_t count) {
+        return std::all_of(indices, indices + count, [](unsigned int i){ return i <= 0xffff; });
+    }
+
+    void narrow(const unsigned int *indices, size_t count) {
+        short_indices.assign(indices, indices + count);
+    }
+
+    std::map<GLint, Storage> attribute_buffers;
+    Storage index_storage;
+    GLenum index_storage_type = GL_UNSIGNED_INT;
+    std::vector<GLushort> short_indices;        // staging for narrowed uploads
+    GLuint vertex_array = 0;
+    uint64_t uploaded_version = 0;
+    GLuint uploaded_program = 0;
+    size_t uploaded_vertices = 0;
+    size_t uploaded_indices = 0;
+};
+
+
+// Ring of `regions` equally sized regions for vertex data that is rewritten
+// every frame. Each frame writes into its own region and fences it once the
+// draws reading it are submitted, so the CPU only ever waits on the GPU when
+// it laps the ring. With buffer storage (GL 4.4 / ARB_buffer_storage) the
+// whole ring stays persistently and coherently mapped and producers write
+// straight into it; otherwise each write maps its range unsynchronized and
+// invalidated, relying on the same fences for safety.
+//
+// A frame that outgrows its region spills into the next ones within the same
+// frame. Only when that is not enough is the buffer orphaned: draws already
+// issued keep reading the old one, which is deleted once its fence passes.
+// The ring is grown at the next fence() so that a whole frame fits a region.
+class StreamBuffer {
+public:
+    StreamBuffer(size_t region_size, int regions = 3): regions(regions), fences(regions, nullptr) {
+        typedef void (*BufferStorageProc)(GLenum, GLsizeiptr, const void*, GLbitfield);
+        buffer_storage = (BufferStorageProc)gl_proc_loader()("glBufferStorage");
+        if (buffer_storage && !has_buffer_storage())
+            buffer_storage = nullptr;
+        allocate(region_size);
+    }
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    ~StreamBuffer() {
+        release();
+    }
+
+    // reserve `bytes` in the current region and return where to write them
+    void* map(size_t bytes) {
+        head = (head + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        if (head + bytes > region_size) {
+            // never fence mid frame: move on to the next region, unless the
+            // write can't fit one or this frame already started there
+            int next = (region + 1) % regions;
+            if (bytes <= region_size && next != first_region) {
+                region = next;
+                head = 0;
+            } else {
+                orphan(std::max(bytes, region_size * 2));
+            }
+        }
+        if (head == 0)
+            wait(region);
+
+        pending_offset = region * region_size + head;
+        head += bytes;
+        frame_bytes += (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+        if (mapped)
+            return mapped + pending_offset;
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        void* ptr = glMapBufferRange(GL_COPY_WRITE_BUFFER, pending_offset, bytes,
+            GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return ptr;
+    }
+
+    template <typename T>
+    T* map(size_t count) {
+        return static_cast<T*>(map(sizeof(T) * count));
+    }
+
+    // finish the write started by map(), returns its byte offset in the buffer
+    size_t unmap() {
+        if (!mapped) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        return pending_offset;
+    }
+
+    // call once per frame after the draws reading this frame's data were issued
+    void fence() {
+        if (frame_bytes > region_size) {
+            // the frame spilled over its region, grow now that nothing reads the new buffer yet
+            orphan(frame_bytes);
+        } else {
+            for (int r = first_region; ; r = (r + 1) % regions) {
+                if (fences[r])
+                    glDeleteSync(fences[r]);
+                fences[r] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                if (r == region)
+                    break;
+            }
+            region = (region + 1) % regions;
+            head = 0;
+        }
+        for (auto& old : retired) {
+            if (!old.sync)
+                old.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        collect(false);
+        first_region = region;
+        frame_bytes = 0;
+    }
+
+    GLuint id() const {
+        return buffer;
+    }
+
+    bool persistent() const {
+        return mapped != nullptr;
+    }
+
+private:
+    static constexpr size_t ALIGNMENT = 64;
+
+    // a buffer replaced by orphan(), alive until the draws reading it are done
+    struct Retired {
+        GLuint buffer = 0;
+        bool mapped = false;
+        GLsync sync = nullptr;      // set by the fence() closing its last frame
+    };
+
+    static bool has_buffer_storage() {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major > 4 || (major == 4 && minor >= 4))
+            return true;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i) {
+            const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (name && std::string(name) == "GL_ARB_buffer_storage")
+                return true;
+        }
+        return false;
+    }
+
+    void allocate(size_t size) {
+        region_size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        region = 0;
+        first_region = 0;
+        head = 0;
+        // what the frame wrote before a mid-frame orphan lives in the retired buffer
+        frame_bytes = 0;
+
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        if (buffer_storage) {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            buffer_storage(GL_COPY_WRITE_BUFFER, region_size * regions, nullptr, flags);
+            mapped = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, region_size * regions, flags));
+        } else {
+            glBufferData(GL_COPY_WRITE_BUFFER, region_size * regions, nullptr, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // retire the current buffer instead of deleting it and start a new one of `size` per region;
+    // the retired buffer's fence also covers every earlier frame, so the region fences go
+    void orphan(size_t size) {
+        retired.push_back(Retired{buffer, mapped != nullptr, nullptr});
+        for (auto& sync : fences) {
+            if (sync) {
+                glDeleteSync(sync);
+                sync = nullptr;
+            }
+        }
+        buffer = 0;
+        mapped = nullptr;
+        allocate(size);
+    }
+
+    // delete the retired buffers the GPU is done with, all of them if `wait`
+    void collect(bool wait) {
+        auto done = [wait](Retired& old) {
+            if (!old.sync)
+                return false;
+            GLenum status = glClientWaitSync(old.sync, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+            if (status == GL_TIMEOUT_EXPIRED)
+                return false;
+            glDeleteSync(old.sync);
+            if (old.mapped) {
+                glBindBuffer(GL_COPY_WRITE_BUFFER, old.buffer);
+                glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            }
+            glDeleteBuffers(1, &old.buffer);
+            return true;
+        };
+        retired.erase(std::remove_if(retired.begin(), retired.end(), done), retired.end());
+    }
+
+    void release() {
+        for (auto& old : retired) {
+            if (!old.sync)
+                old.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        collect(true);
+        for (auto& sync : fences) {
+            if (sync) {
+                glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+                glDeleteSync(sync);
+                sync = nullptr;
+            }
+        }
+        if (buffer != 0) {
+            if (mapped) {
+                glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+                glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            }
+            glDeleteBuffers(1, &buffer);
+        }
+        buffer = 0;
+        mapped = nullptr;
+    }
+
+    void wait(int index) {
+        GLsync sync = fences[index];
+        if (!sync)
+            return;
+        GLenum status = glClientWaitSync(sync, 0, 0);
+        while (status == GL_TIMEOUT_EXPIRED) {
+            status = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        glDeleteSync(sync);
+        fences[index] = nullptr;
+    }
+
+    void (*buffer_storage)(GLenum, GLsizeiptr, const void*, GLbitfield) = nullptr;
+    GLuint buffer = 0;
+    uint8_t* mapped = nullptr;
+    size_t region_size = 0;
+    int regions;
+    int region = 0;
+    int first_region = 0;           // where the current frame started
+    size_t head = 0;
+    size_t pending_offset = 0;
+    size_t frame_bytes = 0;         // written since the last fence()
+    std::vector<GLsync> fences;
+    std::vector<Retired> retired;
+};
+
+// Keyframe poses (camera to world) in a shader storage buffer, read by the
+// anchored shaders as `poses[Anchor]`. Geometry stored in its keyframe's
+// frame follows pose updates without being touched, so re-optimizing the
+// whole trajectory uploads 64 bytes per keyframe and nothing per point.
+class PoseBuffer {
+public:
+    explicit PoseBuffer(GLuint binding = 0): binding(binding) {}
+
+    PoseBuffer(const PoseBuffer&) = delete;
+    PoseBuffer& operator=(const PoseBuffer&) = delete;
+
+    ~PoseBuffer() {
+        if (buffer != 0)
+            glDeleteBuffers(1, &buffer);
+    }
+
+    // set the pose of keyframe `index`, growing the buffer to cover it
+    void set(size_t index, const mat4f& pose) {
+        if (index >= poses.size())
+            poses.resize(index + 1, mat4f::Identity());
+        poses[index] = pose;
+        mark(index, index + 1);
+    }
+
+    // replace all poses at once, e.g. after a loop closure
+    void set(const std::vector<mat4f>& all) {
+        poses = all;
+        mark(0, poses.size());
+    }
+
+    const mat4f& get(size_t index) const {
+        return poses[index];
+    }
+
+    size_t size() const {
+        return poses.size();
+    }
+
+    // send what changed since the last call and bind to `binding`
+    void bind() {
+        if (buffer == 0)
+            glGenBuffers(1, &buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        if (capacity < poses.size()) {
+            capacity = std::max(poses.size(), capacity * 2);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(mat4f) * capacity, nullptr, GL_DYNAMIC_DRAW);
+            dirty_first = 0;
+            dirty_last = poses.size();
+        }
+        if (dirty_first < dirty_last) {
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(mat4f) * dirty_first,
+                sizeof(mat4f) * (dirty_last - dirty_first), poses[dirty_first].data());
+            gl_counters().bytes_uploaded += sizeof(mat4f) * (dirty_last - dirty_first);
+            dirty_first = dirty_last = 0;
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+    }
+
+private:
+    void mark(size_t first, size_t last) {
+        if (dirty_first == dirty_last) {
+            dirty_first = first;
+            dirty_last = last;
+        } else {
+            dirty_first = std::min(dirty_first, first);
+            dirty_last = std::max(dirty_last, last);
+        }
+    }
+
+    std::vector<mat4f> poses;
+    GLuint binding;
+    GLuint buffer = 0;
+    size_t capacity = 0;            // poses allocated on the GPU
+    size_t dirty_first = 0;         // range of poses to send on the next bind()
+    size_t dirty_last = 0;
+};
+
+
 class Shader {
 public:
     Shader(const char *vshader_path, const char *fshader_path, bool create_buffer = true) {
@@ -198,8 +864,10 @@ public:
         if(use_buffer) {
             glBindVertexArray(vertex_array);
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+            ++gl_counters().vao_binds;
         }
         glUseProgram(program);
+        ++gl_counters().program_binds;
     }
 
     void unbind(bool use_buffer = true) {
@@ -214,49 +882,57 @@ public:
         return program;
     }
 
-    void set_uniform(const std::string &name, const size_t &value) {
+    void set_uniform(std::string_view name, const size_t &value) {
         GLint uni = uniform(name);
         glUniform1i(uni, value);
+        ++gl_counters().uniform_updates;
     }
 
-    void set_uniform(const std::string &name, const int &value) {
+    void set_uniform(std::string_view name, const int &value) {
         GLint uni = uniform(name);
         glUniform1i(uni, value);
+        ++gl_counters().uniform_updates;
     }
 
-    void set_uniform(const std::string &name, const float &value) {
+    void set_uniform(std::string_view name, const float &value) {
         GLint uni = uniform(name);
         glUniform1f(uni, value);
+        ++gl_counters().uniform_updates;
     }
 
-    void set_uniform(const std::string &name, const vec2f &vector) {
+    void set_uniform(std::string_view name, const vec2f &vector) {
         GLint uni = uniform(name);
         glUniform2fv(uni, 1, vector.data());
+        ++gl_counters().uniform_updates;
     }
 
-    void set_uniform(const std::string &name, const vec3f &vector) {
+    void set_uniform(std::string_view name, const vec3f &vector) {
         GLint uni = uniform(name);
         glUniform3fv(uni, 1, vector.data());
+        ++gl_counters().uniform_updates;
     }
 
-    void set_uniform(const std::string &name, const vec4f &vector) {
+    void set_uniform(std::string_view name, const vec4f &vector) {
         GLint uni = uniform(name);
         glUniform4fv(uni, 1, vector.data());
+        ++gl_counters().uniform_updates;
     }
 
-    void set_uniform(const std::string &name, const mat4f &matrix) {
+    void set_uniform(std::string_view name, const mat4f &matrix) {
         GLint uni = uniform(name);
         glUniformMatrix4fv(uni, 1, GL_FALSE, matrix.data());
+        ++gl_counters().uniform_updates;
     }
 
     // texture
-    void set_uniform(const std::string &name) {
+    void set_uniform(std::string_view name) {
         GLint uni = uniform(name);
         glUniform1i(uni, 0);
+        ++gl_counters().uniform_updates;
     }
 
     template <typename E, int N>
-    void set_attribute(const std::string &name,
+    void set_attribute(std::string_view name,
                     const std::vector<Eigen::Matrix<E, N, 1>> &data) {
         GLint attrib = attribute(name);
         if (attribute_buffers.count(attrib) == 0) {
@@ -267,26 +943,124 @@ public:
         GLuint buffer = attribute_buffers.at(attrib);
         glBindBuffer(GL_ARRAY_BUFFER, buffer);
         glBufferData(GL_ARRAY_BUFFER, sizeof(E) * N * data.size(), &data[0], GL_DYNAMIC_DRAW);
+        gl_counters().bytes_uploaded += sizeof(E) * N * data.size();
         glEnableVertexAttribArray(attrib);
         glVertexAttribPointer(attrib, N, get_type_enum<E>(), is_type_integral<E>(), 0, nullptr);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
+    // upload into a buffer owned by the caller instead of the shader's own one
+    template <typename E, int N>
+    void set_attribute(VertexBuffer &buffer, std::string_view name,
+                    const std::vector<Eigen::Matrix<E, N, 1>> &data) {
+        buffer.set_attribute(attribute(name), data);
+    }
+
+    template <typename E, int N>
+    void set_attribute(VertexBuffer &buffer, std::string_view name,
+                    const Eigen::Matrix<E, N, 1> *data, size_t count) {
+        buffer.set_attribute(attribute(name), data, count);
+    }
+
+    template <typename E, int N>
+    void append_attribute(VertexBuffer &buffer, std::string_view name,
+                    const std::vector<Eigen::Matrix<E, N, 1>> &data, size_t first) {
+        buffer.append_attribute(attribute(name), data, first);
+    }
+
+    // point `name` at data written into `stream` between map() and unmap(),
+    // `offset` is the value unmap() returned
+    template <typename E, int N>
+    void set_attribute(const StreamBuffer &stream, std::string_view name, size_t offset) {
+        GLint attrib = attribute(name);
+        glBindBuffer(GL_ARRAY_BUFFER, stream.id());
+        glEnableVertexAttribArray(attrib);
+        glVertexAttribPointer(attrib, N, get_type_enum<E>(), is_type_integral<E>(), 0, (const void *)offset);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    template <typename E, int N>
+    void update_attribute(VertexBuffer &buffer, std::string_view name,
+                    const std::vector<Eigen::Matrix<E, N, 1>> &data, size_t first, size_t count) {
+        buffer.update_attribute(attribute(name), data, first, count);
+    }
+
+    template <typename E>
+    void set_integer_attribute(VertexBuffer &buffer, std::string_view name, const std::vector<E> &data) {
+        buffer.set_integer_attribute(attribute(name), data);
+    }
+
+    template <typename E>
+    void append_integer_attribute(VertexBuffer &buffer, std::string_view name,
+                    const std::vector<E> &data, size_t first) {
+        buffer.append_integer_attribute(attribute(name), data, first);
+    }
+
+    // point `name` at one field of the interleaved per-instance records in
+    // `buffer`, advancing once per instance. T is the Eigen type of the field,
+    // matrices take one attribute location per column
+    template <typename T>
+    void set_instance_attribute(GLuint buffer, std::string_view name, size_t stride, size_t offset) {
+        using E = typename T::Scalar;
+        constexpr int R = T::RowsAtCompileTime;
+        GLint attrib = attribute(name);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        for (int c = 0; c < T::ColsAtCompileTime; ++c) {
+            glEnableVertexAttribArray(attrib + c);
+            glVertexAttribPointer(attrib + c, R, get_type_enum<E>(), is_type_integral<E>(), stride,
+                (const void *)(offset + sizeof(E) * R * c));
+            glVertexAttribDivisor(attrib + c, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // streaming counterpart of set_attribute(name, data) for data that changes every frame
+    template <typename E, int N>
+    void stream_attribute(StreamBuffer &stream, std::string_view name,
+                    const std::vector<Eigen::Matrix<E, N, 1>> &data) {
+        void* ptr = stream.map(sizeof(E) * N * data.size());
+        std::memcpy(ptr, data.data(), sizeof(E) * N * data.size());
+        gl_counters().bytes_uploaded += sizeof(E) * N * data.size();
+        set_attribute<E, N>(stream, name, stream.unmap());
+    }
+
     void set_indices(const std::vector<unsigned int> &indices) {
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), &indices[0], GL_DYNAMIC_DRAW);
+        gl_counters().bytes_uploaded += sizeof(unsigned int) * indices.size();
     }
 
 
     void draw(GLenum mode, GLuint start, GLuint count) {
         glDrawArrays(mode, start, count);
+        counted(mode, count);
     }
 
-    void draw_indexed(GLenum mode, GLuint start, GLuint count) {
-        glDrawElements(mode, count, GL_UNSIGNED_INT, (const void *)(start * sizeof(GLuint)));
+    // one call for several ranges [first[i], first[i] + count[i]) of the bound vertex arrays
+    void draw_multi(GLenum mode, const GLint* first, const GLsizei* count, GLsizei drawcount) {
+        glMultiDrawArrays(mode, first, count, drawcount);
+        for (GLsizei i = 0; i < drawcount; ++i)
+            gl_counters().primitives += gl_primitive_count(mode, count[i]);
+        ++gl_counters().draw_calls;
+    }
+
+    void draw_instanced(GLenum mode, GLuint start, GLuint count, GLsizei instances) {
+        glDrawArraysInstanced(mode, start, count, instances);
+        counted(mode, count, instances);
+    }
+
+    void draw_indexed(GLenum mode, GLuint start, GLuint count, GLenum type = GL_UNSIGNED_INT) {
+        size_t size = type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : type == GL_UNSIGNED_BYTE ? sizeof(GLubyte) : sizeof(GLuint);
+        glDrawElements(mode, count, type, (const void *)(start * size));
+        counted(mode, count);
     }
 
 private:
+    static void counted(GLenum mode, size_t count, size_t instances = 1) {
+        ++gl_counters().draw_calls;
+        gl_counters().primitives += gl_primitive_count(mode, count) * instances;
+    }
+
     std::string readShaderSourceFromFile(const std::string& filePath) {
         std::ifstream file(filePath);
         if (!file.is_open()) {
@@ -298,36 +1072,41 @@ private:
         return buffer.str();
     }
 
-    GLint uniform(const std::string &name) {
-        if (uniforms.count(name) == 0) {
-            GLint location = glGetUniformLocation(program, name.c_str());
+    // names are looked up as views, only the first lookup of a name builds a string
+    GLint uniform(std::string_view name) {
+        auto it = uniforms.find(name);
+        if (it == uniforms.end()) {
+            std::string key(name);
+            GLint location = glGetUniformLocation(program, key.c_str());
             if (location == -1) {
                 std::cerr << "Error: cannot find uniform '" << name << "'\n";
                 exit(1);
             }
-            uniforms[name] = location;
+            it = uniforms.emplace(std::move(key), location).first;
         }
-        return uniforms.at(name);
+        return it->second;
     }
 
-    GLint attribute(const std::string &name) {
-        if (attributes.count(name) == 0) {
-            GLint location = glGetAttribLocation(program, name.c_str());
+    GLint attribute(std::string_view name) {
+        auto it = attributes.find(name);
+        if (it == attributes.end()) {
+            std::string key(name);
+            GLint location = glGetAttribLocation(program, key.c_str());
             if (location == -1) {
                 puts("Error getting attribute location.");
                 exit(0);
             }
-            attributes[name] = location;
+            it = attributes.emplace(std::move(key), location).first;
         }
-        return attributes.at(name);
+        return it->second;
     }
 
     GLuint program;
     GLuint vshader;
     GLuint fshader;
     GLuint gshader;
-    std::map<std::string, GLint> uniforms;
-    std::map<std::string, GLint> attributes;
+    std::map<std::string, GLint, std::less<>> uniforms;
+    std::map<std::string, GLint, std::less<>> attributes;
     std::map<GLint, GLuint> attribute_buffers;
     GLuint index_buffer = 0;
     GLuint vertex_array = 0;
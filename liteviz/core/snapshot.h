@@ -0,0 +1,228 @@
+#ifndef __LITEVIZ_SNAPSHOT_H__
+#define __LITEVIZ_SNAPSHOT_H__
+
+#include <liteviz/core/common.h>
+#include <liteviz/core/shader.h>
+#include <liteviz/core/viewport.h>
+#include <liteviz/core/mesh.h>
+#include <liteviz/core/base_renderer.h>
+#include <liteviz/core/update_queue.h>
+
+#include <limits>
+#include <set>
+
+namespace liteviz {
+
+// Complete CPU-side scene state, built by a producer thread and published
+// through a SceneExchange. Snapshots are never changed once published: the
+// next one is derive()d, which shares every mesh, and only the meshes that
+// are set() or edit()ed are new objects. Since the GPU copy lives in the mesh,
+// shared meshes are drawn from what is already uploaded and new ones upload
+// once, which shares() tells the renderer per mesh. An edited mesh is a
+// full copy, except for QuantizedPointCloud, whose copies share the chunks
+// they leave alone; large clouds that keep growing are best kept in one.
+//
+//     auto current = viewer.createScene();
+//     ...
+//     auto next = current->derive();
+//     next->edit<QuantizedPointCloud>("map")->append(points, COLOR_WHITE);
+//     viewer.publish(next);
+//     current = next;
+//
+// Meshes own GL objects, so their last reference has to be dropped on the
+// render thread: snapshots from createScene() and everything derived from
+// them hand their meshes to the viewer's retire queue, which it empties
+// before drawing. Meshes must not be modified once they are in a published
+// snapshot, and are best kept in snapshots only.
+class SceneSnapshot {
+public:
+    struct Entry {
+        std::shared_ptr<Mesh> mesh;
+        std::string shader;         // key of the shader in SnapshotRenderer
+    };
+
+    // without a retire queue meshes go wherever their last reference drops,
+    // fine for snapshots that are never drawn
+    explicit SceneSnapshot(std::shared_ptr<UpdateQueue> retired = nullptr): retired(std::move(retired)) {}
+
+    // next snapshot, sharing all meshes with this one
+    std::shared_ptr<SceneSnapshot> derive() const {
+        auto next = std::make_shared<SceneSnapshot>(retired);
+        next->meshes = meshes;
+        next->generation = generation + 1;
+        return next;
+    }
+
+    void set(const std::string& name, std::shared_ptr<Mesh> mesh, const std::string& shader = "point"){
+        Mesh* raw = mesh.get();
+        Entry& entry = meshes[name];
+        if(entry.mesh)
+            owned.erase(entry.mesh.get());
+        if(retired){
+            entry.mesh = std::shared_ptr<Mesh>(raw, [owner = std::move(mesh), queue = retired](Mesh*) mutable {
+                queue->push([owner = std::move(owner)](){});
+            });
+        }else{
+            entry.mesh = std::move(mesh);
+        }
+        entry.shader = shader;
+        owned.insert(raw);
+    }
+
+    // copy-on-write access to the mesh `name` for changing it in this
+    // snapshot, nullptr if there is none of type T. A mesh shared with an
+    // earlier snapshot is cloned first through Mesh::clone(), keeping its
+    // dynamic type; the clone starts without GPU buffers. Meshes that change
+    // CPU state in draw() (LODPointCloud, PointStore, FrustumSet,
+    // OutOfCorePointCloud) have no clone() and can only be replaced with set()
+    template <typename T>
+    std::shared_ptr<T> edit(const std::string& name){
+        auto it = meshes.find(name);
+        if(it == meshes.end())
+            return nullptr;
+        auto mesh = std::dynamic_pointer_cast<T>(it->second.mesh);
+        if(!mesh || owned.count(mesh.get()))
+            return mesh;
+        auto copy = mesh->clone();
+        if(!copy){
+            std::cerr << "Mesh " << name << " can't be cloned for editing, set() a new one instead" << std::endl;
+            return nullptr;
+        }
+        set(name, std::move(copy), it->second.shader);
+        return std::static_pointer_cast<T>(it->second.mesh);
+    }
+
+    void erase(const std::string& name){
+        auto it = meshes.find(name);
+        if(it == meshes.end())
+            return;
+        owned.erase(it->second.mesh.get());
+        meshes.erase(it);
+    }
+
+    std::shared_ptr<Mesh> get(const std::string& name) const {
+        auto it = meshes.find(name);
+        return it == meshes.end() ? nullptr : it->second.mesh;
+    }
+
+    const std::map<std::string, Entry>& entries() const {
+        return meshes;
+    }
+
+    // true if `name` is the very same mesh in `other`, i.e. its GPU copy is still valid
+    bool shares(const std::string& name, const SceneSnapshot& other) const {
+        auto a = meshes.find(name);
+        auto b = other.meshes.find(name);
+        return a != meshes.end() && b != other.meshes.end() && a->second.mesh == b->second.mesh;
+    }
+
+    uint64_t getGeneration() const {
+        return generation;
+    }
+
+    const std::shared_ptr<UpdateQueue>& getRetireQueue() const {
+        return retired;
+    }
+
+private:
+    std::shared_ptr<UpdateQueue> retired;
+    std::map<std::string, Entry> meshes;
+    std::set<const Mesh*> owned;       // meshes created in this snapshot, edited in place
+    uint64_t generation = 0;
+};
+
+// Latest-wins handoff of snapshots from producers to the render thread.
+// Publishing and acquiring are one atomic pointer swap each; snapshots that
+// are overtaken before the render thread gets to them are never drawn.
+class SceneExchange {
+public:
+    // any thread: empty snapshot whose meshes, and those of every snapshot
+    // derived from it, are released by this exchange's acquire()
+    std::shared_ptr<SceneSnapshot> create() const {
+        return std::make_shared<SceneSnapshot>(retired);
+    }
+
+    // any thread, the snapshot has to come from create()
+    void publish(std::shared_ptr<const SceneSnapshot> snapshot){
+        if(snapshot && snapshot->getRetireQueue() != retired){
+            std::cerr << "Snapshot was not created by this viewer, its meshes would be released off the render thread" << std::endl;
+            return;
+        }
+        std::atomic_store_explicit(&latest, std::move(snapshot), std::memory_order_release);
+        trace_recorder().instant("publish", "update");
+    }
+
+    // render thread, also releases meshes dropped by snapshots
+    std::shared_ptr<const SceneSnapshot> acquire(){
+        retired->drain(std::numeric_limits<double>::infinity());
+        return std::atomic_load_explicit(&latest, std::memory_order_acquire);
+    }
+
+private:
+    std::shared_ptr<const SceneSnapshot> latest;
+    // shared with the meshes' deleters, which may outlive the exchange
+    std::shared_ptr<UpdateQueue> retired = std::make_shared<UpdateQueue>("retire");
+};
+
+// Draws every mesh of a snapshot with the shader registered under its key.
+class SnapshotRenderer: public BaseRenderer {
+public:
+    void setShader(const std::string& key, std::shared_ptr<Shader> shader){
+        shaders[key] = shader;
+    }
+
+    // "point", "frustum" and "anchored" from the shader sources in `dir`, needs a current context
+    void loadShaders(const std::string& dir){
+        setShader("point", std::make_shared<Shader>(
+            (dir + "/draw_point.vert").c_str(), (dir + "/draw_point.frag").c_str()));
+        setShader("frustum", std::make_shared<Shader>(
+            (dir + "/draw_frustum.vert").c_str(), (dir + "/draw_point.frag").c_str()));
+        setShader("anchored", std::make_shared<Shader>(
+            (dir + "/draw_anchored.vert").c_str(), (dir + "/draw_point.frag").c_str()));
+    }
+
+    // latch the snapshot drawn by render() until the next call
+    void setScene(std::shared_ptr<const SceneSnapshot> snapshot){
+        if(snapshot == scene)
+            return;
+        uploads = 0;
+        if(snapshot){
+            for(const auto& entry : snapshot->entries()){
+                if(!scene || !snapshot->shares(entry.first, *scene))
+                    ++uploads;
+            }
+        }
+        scene = std::move(snapshot);
+    }
+
+    const std::shared_ptr<const SceneSnapshot>& getScene() const {
+        return scene;
+    }
+
+    // meshes of the current snapshot that were not in the previous one and upload on their first draw
+    size_t getUploads() const {
+        return uploads;
+    }
+
+    void render(const Viewport& viewport) override {
+        if(!scene)
+            return;
+        for(const auto& [name, entry] : scene->entries()){
+            auto it = shaders.find(entry.shader);
+            if(it == shaders.end()){
+                std::cerr << "No shader '" << entry.shader << "' for mesh " << name << std::endl;
+                continue;
+            }
+            entry.mesh->draw(it->second.get(), viewport);
+        }
+    }
+
+private:
+    std::map<std::string, std::shared_ptr<Shader>> shaders;
+    std::shared_ptr<const SceneSnapshot> scene;
+    size_t uploads = 0;
+};
+
+} // namespace liteviz
+
+#endif // __LITEVIZ_SNAPSHOT_H__
@@ -0,0 +1,96 @@
+#ifndef __LITEVIZ_UPDATE_QUEUE_H__
+#define __LITEVIZ_UPDATE_QUEUE_H__
+
+#include <liteviz/core/common.h>
+#include <liteviz/core/utils.h>
+
+#include <atomic>
+
+namespace liteviz {
+
+// Scene updates from other threads. Producers (tracking, mapping, loop
+// closure, ...) push commands that touch meshes, poses or colors, the render
+// thread runs them between frames, so meshes are only ever modified on the
+// thread that draws them:
+//
+//     auto cloud = std::make_shared<PointCloud>();
+//     viewer.post([cloud, points = std::move(points)]{ cloud->append(points, COLOR_RED); });
+//
+// Multi-producer single-consumer queue after Dmitry Vyukov: push is one
+// atomic exchange and never waits for the consumer or other producers, pop is
+// run by the render thread only.
+class UpdateQueue {
+public:
+    using Command = std::function<void()>;
+
+    // `event` names the trace instant recorded per push
+    explicit UpdateQueue(const char* event = "post"): head(new Node), tail(head.load()), event(event) {}
+
+    UpdateQueue(const UpdateQueue&) = delete;
+    UpdateQueue& operator=(const UpdateQueue&) = delete;
+
+    ~UpdateQueue() {
+        Command command;
+        while (pop(command)) {}
+        delete tail;
+    }
+
+    // any thread
+    void push(Command command) {
+        Node* node = new Node;
+        node->command = std::move(command);
+        pending.fetch_add(1, std::memory_order_relaxed);
+        Node* prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+        trace_recorder().instant(event, "update");
+    }
+
+    // consumer only. May miss a command whose push is still in progress,
+    // it is picked up by a later call
+    bool pop(Command& command) {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next)
+            return false;
+        command = std::move(next->command);
+        delete tail;
+        tail = next;
+        pending.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // consumer only. Runs queued commands until the queue is empty or
+    // `budget` seconds have passed, at least one if any is queued; the rest
+    // wait for the next call. Returns the number of commands run
+    size_t drain(double budget) {
+        Timer timer;
+        Command command;
+        size_t count = 0;
+        while (pop(command)) {
+            command();
+            ++count;
+            if (timer.elapsed() >= budget)
+                break;
+        }
+        return count;
+    }
+
+    // approximate number of queued commands
+    size_t size() const {
+        return pending.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        Command command;
+    };
+
+    alignas(64) std::atomic<Node*> head;    // last pushed, shared by producers
+    alignas(64) Node* tail;                 // consumed stub, consumer only
+    std::atomic<size_t> pending{0};
+    const char* event;
+};
+
+} // namespace liteviz
+
+#endif // __LITEVIZ_UPDATE_QUEUE_H__
@@ -2,11 +2,206 @@
 #define __LITEVIZ_UTILS_H__
 
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <chrono>
+#include <atomic>
+#include <vector>
+#include <set>
+#include <map>
+#include <mutex>
+#include <cstdio>
 
 namespace liteviz {
 
+// Process-wide timeline for post-mortem analysis of hitches, written as
+// Chrome Trace Event JSON (chrome://tracing, ui.perfetto.dev). Any thread
+// records into a bounded ring without locking; the oldest events are
+// overwritten. While disabled, which is the default, a scope costs one
+// relaxed atomic load:
+//
+//     trace_recorder().setEnabled(true);
+//     { LITEVIZ_TRACE_SCOPE("load chunk", "io"); ... }
+//     trace_recorder().dump("trace.json");
+class TraceRecorder {
+public:
+    using Clock = std::chrono::high_resolution_clock;
+
+    struct Event {
+        const char* name;
+        const char* category;
+        int64_t start;          // ns since the recorder was created
+        int64_t duration;       // ns, -1 for instant events
+        uint32_t thread;
+    };
+
+    explicit TraceRecorder(size_t capacity = 1 << 16): slots(capacity) {}
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    void setEnabled(bool enabled) {
+        this->enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool isEnabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    // `name` and `category` have to stay valid, i.e. literals or intern()ed
+    void record(const char* name, const char* category, Clock::time_point start, Clock::time_point end) {
+        write(name, category, nanoseconds(start), std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    void instant(const char* name, const char* category = "event") {
+        if (isEnabled())
+            write(name, category, nanoseconds(Clock::now()), -1);
+    }
+
+    // stable copy of a name built at run time
+    const char* intern(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return names.insert(name).first->c_str();
+    }
+
+    // label for the calling thread in the dump
+    void setThreadName(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        thread_names[thread_id()] = name;
+    }
+
+    // consistent copy of the ring, oldest first; events being written are left out
+    std::vector<Event> events() const {
+        std::vector<Event> out;
+        uint64_t end = next.load(std::memory_order_acquire);
+        uint64_t begin = end > slots.size() ? end - slots.size() : 0;
+        out.reserve(end - begin);
+        for (uint64_t i = begin; i < end; ++i) {
+            const Slot& slot = slots[i % slots.size()];
+            uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq != 2 * i + 2)
+                continue;
+            Event event;
+            event.name = slot.name.load(std::memory_order_relaxed);
+            event.category = slot.category.load(std::memory_order_relaxed);
+            event.start = slot.start.load(std::memory_order_relaxed);
+            event.duration = slot.duration.load(std::memory_order_relaxed);
+            event.thread = slot.thread.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == seq)
+                out.push_back(event);
+        }
+        return out;
+    }
+
+    // write the ring as Chrome Trace Event JSON
+    bool dump(const std::string& path) const {
+        std::vector<Event> recorded = events();
+        std::ofstream file(path);
+        if (!file) {
+            std::cerr << "Failed to open " << path << " for the trace" << std::endl;
+            return false;
+        }
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        auto separate = [&]() {
+            if (!first)
+                file << ",\n";
+            first = false;
+        };
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto& [thread, name] : thread_names) {
+                separate();
+                file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+                     << ",\"args\":{\"name\":\"" << escape(name.c_str()) << "\"}}";
+            }
+        }
+        char time[64];
+        for (const Event& event : recorded) {
+            separate();
+            file << "{\"name\":\"" << escape(event.name) << "\",\"cat\":\"" << escape(event.category)
+                 << "\",\"pid\":1,\"tid\":" << event.thread;
+            std::snprintf(time, sizeof(time), "%.3f", event.start * 1e-3);
+            file << ",\"ts\":" << time;
+            if (event.duration < 0) {
+                file << ",\"ph\":\"i\",\"s\":\"t\"}";
+            } else {
+                std::snprintf(time, sizeof(time), "%.3f", event.duration * 1e-3);
+                file << ",\"ph\":\"X\",\"dur\":" << time << "}";
+            }
+        }
+        file << "\n]}\n";
+        return bool(file);
+    }
+
+    // drop everything recorded so far, not while other threads record
+    void clear() {
+        next.store(0, std::memory_order_release);
+        for (auto& slot : slots)
+            slot.seq.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq{0};           // odd while written, 2 * index + 2 once complete
+        std::atomic<const char*> name{nullptr};
+        std::atomic<const char*> category{nullptr};
+        std::atomic<int64_t> start{0};
+        std::atomic<int64_t> duration{0};
+        std::atomic<uint32_t> thread{0};
+    };
+
+    void write(const char* name, const char* category, int64_t start, int64_t duration) {
+        uint64_t index = next.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = slots[index % slots.size()];
+        slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.category.store(category, std::memory_order_relaxed);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.duration.store(duration, std::memory_order_relaxed);
+        slot.thread.store(thread_id(), std::memory_order_relaxed);
+        slot.seq.store(2 * index + 2, std::memory_order_release);
+    }
+
+    int64_t nanoseconds(Clock::time_point time) const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time - origin).count();
+    }
+
+    // small sequential ids read better in trace viewers than native handles
+    static uint32_t thread_id() {
+        static std::atomic<uint32_t> counter{0};
+        thread_local uint32_t id = ++counter;
+        return id;
+    }
+
+    static std::string escape(const char* text) {
+        std::string out;
+        for (; text && *text; ++text) {
+            if (*text == '"' || *text == '\\')
+                out += '\\';
+            if (static_cast<unsigned char>(*text) >= 0x20)
+                out += *text;
+        }
+        return out;
+    }
+
+    std::vector<Slot> slots;
+    std::atomic<uint64_t> next{0};
+    std::atomic<bool> enabled{false};
+    Clock::time_point origin = Clock::now();
+
+    mutable std::mutex mutex;                   // guards names and thread_names
+    std::set<std::string> names;
+    std::map<uint32_t, std::string> thread_names;
+};
+
+inline TraceRecorder& trace_recorder() {
+    static TraceRecorder recorder;
+    return recorder;
+}
+
 class Timer {
 public:
     Timer() : start_time(std::chrono::high_resolution_clock::now()) {}
@@ -20,13 +215,59 @@ public:
         return std::chrono::duration<double>(end_time - start_time).count();
     }
 
+    double elapsedMs() const {
+        return elapsed() * 1000.0;
+    }
+
     void printElapsed(const std::string& message = "Elapsed time: ") const {
         std::cout << message << elapsed() << " seconds" << std::endl;
     }
+
+    // put the time since the start on the trace timeline, if tracing
+    void record(const char* name, const char* category = "timer") const {
+        if (trace_recorder().isEnabled())
+            trace_recorder().record(name, category, start_time, std::chrono::high_resolution_clock::now());
+    }
+
 private:
     std::chrono::high_resolution_clock::time_point start_time;
 };
 
+// Traces its own lifetime. Only reads the clock while tracing, use through
+// LITEVIZ_TRACE_SCOPE, which compiles away with LITEVIZ_NO_TRACE.
+class TraceScope {
+public:
+    explicit TraceScope(const char* name, const char* category = "scope"): name(name), category(category) {
+        if (trace_recorder().isEnabled()) {
+            active = true;
+            start = TraceRecorder::Clock::now();
+        }
+    }
+
+    ~TraceScope() {
+        if (active)
+            trace_recorder().record(name, category, start, TraceRecorder::Clock::now());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    const char* category;
+    bool active = false;
+    TraceRecorder::Clock::time_point start;
+};
+
 } // namespace liteviz
 
-#endif // __LITEVIZ_UTILS_H__
\ No newline at end of file
+#define LITEVIZ_TRACE_CONCAT_(a, b) a##b
+#define LITEVIZ_TRACE_CONCAT(a, b) LITEVIZ_TRACE_CONCAT_(a, b)
+
+#ifdef LITEVIZ_NO_TRACE
+#define LITEVIZ_TRACE_SCOPE(...) do {} while (0)
+#else
+#define LITEVIZ_TRACE_SCOPE(...) liteviz::TraceScope LITEVIZ_TRACE_CONCAT(trace_scope_, __LINE__)(__VA_ARGS__)
+#endif
+
+#endif // __LITEVIZ_UTILS_H__
@@ -301,6 +301,49 @@ public:
     }
 };
 
+// Clip volume of a viewport in world coordinates, used to cull and rank
+// spatial nodes (octree cells, on-disk chunks) before they are drawn.
+class ViewFrustum {
+public:
+    ViewFrustum(const Viewport& viewport){
+        mat4f M = viewport.getProjectionMatrix() * viewport.getViewMatrix();
+        planes[0] = M.row(3) + M.row(0);
+        planes[1] = M.row(3) - M.row(0);
+        planes[2] = M.row(3) + M.row(1);
+        planes[3] = M.row(3) - M.row(1);
+        planes[4] = M.row(3) + M.row(2);
+        planes[5] = M.row(3) - M.row(2);
+        for(auto& plane : planes){
+            plane /= plane.head<3>().norm();
+        }
+        eye = viewport.getCameraPosition();
+        zNear = viewport.zNear;
+        // pixels per unit length at distance 1
+        pixelScale = viewport.frameBufferSize.y() / (2.0f * tan((viewport.fov / 180.0f * M_PI) / 2.0f));
+    }
+
+    // false only if the axis-aligned box lies completely outside one of the planes
+    bool intersects(const vec3f& center, const vec3f& half) const {
+        for(const auto& plane : planes){
+            float r = half.dot(plane.head<3>().cwiseAbs());
+            if(plane.head<3>().dot(center) + plane.w() < -r)
+                return false;
+        }
+        return true;
+    }
+
+    // on-screen size in pixels of a length `size` seen at `center`, boxes containing the eye count as huge
+    float projectedSize(const vec3f& center, float radius, float size) const {
+        float distance = (center - eye).norm() - radius;
+        return size * pixelScale / std::max(distance, zNear);
+    }
+
+    std::array<vec4f, 6> planes;
+    vec3f eye;
+    float zNear;
+    float pixelScale;
+};
+
 } // namespace liteviz
 
 #endif
\ No newline at end of file
@@ -0,0 +1,328 @@
+#ifndef __LITEVIZ_WORKLOAD_H__
+#define __LITEVIZ_WORKLOAD_H__
+
+#include <liteviz/core/common.h>
+#include <liteviz/core/shader.h>
+#include <liteviz/core/viewport.h>
+#include <liteviz/core/mesh.h>
+#include <liteviz/core/anchored.h>
+#include <liteviz/core/frustum_set.h>
+#include <liteviz/core/base_renderer.h>
+#include <liteviz/core/image.h>
+#include <liteviz/core/profiler.h>
+#include <liteviz/core/update_queue.h>
+
+#include <atomic>
+#include <random>
+
+namespace liteviz {
+
+// One tracking frame of a simulated SLAM session, see SlamWorkload.
+struct SlamStep {
+    uint64_t frame = 0;
+    double time = 0.0;                  // simulated seconds since the start
+    mat4f pose;                         // estimated camera to world
+    bool keyframe = false;              // a keyframe was created at `pose`
+    size_t keyframe_index = 0;          // valid if `keyframe`
+    std::vector<vec3f> points;          // new map points in the keyframe's frame
+    std::vector<vec4f> colors;
+    std::vector<std::pair<size_t, mat4f>> corrected;    // keyframes moved by an optimization
+    Image image;                        // RGB camera image, empty if disabled
+    std::chrono::steady_clock::time_point created;      // for measuring update latency
+};
+
+// Deterministic stand-in for a SLAM backend, for reproducing production load
+// without a dataset. The camera flies a closed loop through a room; every
+// keyframe_interval frames a keyframe is created with points_per_keyframe new
+// map points, and its estimated pose drifts a little further from the true
+// one. Every optimize_interval keyframes an optimization snaps the newest
+// optimize_fraction of the keyframes back, like a loop closure. The same seed
+// and config always give the same steps. CPU only, any thread.
+class SlamWorkload {
+public:
+    struct Config {
+        uint32_t seed = 1;
+        double rate = 30.0;                 // tracking frames per second
+        float speed = 0.5f;                 // m/s along the trajectory
+        int keyframe_interval = 10;         // tracking frames per keyframe
+        size_t points_per_keyframe = 1000;
+        int optimize_interval = 20;         // keyframes between optimizations, 0 never
+        float optimize_fraction = 0.25f;    // newest share of the keyframes corrected
+        float drift = 0.002f;               // rad and m of drift added per keyframe
+        int image_width = 320;              // camera images, 0 for none
+        int image_height = 240;
+    };
+
+    SlamWorkload(): SlamWorkload(Config()) {}
+
+    explicit SlamWorkload(const Config& config): config(config), rng(config.seed) {
+        drift = mat4f::Identity();
+    }
+
+    const Config& getConfig() const {
+        return config;
+    }
+
+    size_t getKeyframes() const {
+        return keyframes.size();
+    }
+
+    size_t getPoints() const {
+        return keyframes.size() * config.points_per_keyframe;
+    }
+
+    SlamStep next() {
+        SlamStep step;
+        step.frame = frame;
+        step.time = frame / config.rate;
+        step.created = std::chrono::steady_clock::now();
+
+        mat4f truth = truePose(float(step.time) * config.speed);
+        step.pose = truth * drift;
+
+        if (config.keyframe_interval > 0 && frame % config.keyframe_interval == 0) {
+            addDrift();
+            step.pose = truth * drift;
+            step.keyframe = true;
+            step.keyframe_index = keyframes.size();
+            keyframes.push_back(truth);
+            observe(step);
+
+            if (config.optimize_interval > 0 && keyframes.size() % config.optimize_interval == 0)
+                optimize(step);
+        }
+
+        if (config.image_width > 0 && config.image_height > 0)
+            render(step);
+
+        ++frame;
+        return step;
+    }
+
+private:
+    // closed loop around a 8 x 5 m room at eye height, looking ahead
+    static mat4f truePose(float distance) {
+        float u = distance / 3.3f;
+        vec3f position(4.0f * std::cos(u), 2.5f * std::sin(u), 1.5f + 0.2f * std::sin(3.0f * u));
+        vec3f forward = vec3f(-4.0f * std::sin(u), 2.5f * std::cos(u), 0.6f * std::cos(3.0f * u)).normalized();
+        vec3f right = forward.cross(vec3f::UnitZ()).normalized();
+        mat4f pose = mat4f::Identity();
+        pose.block<3, 1>(0, 0) = right;
+        pose.block<3, 1>(0, 1) = forward.cross(right);
+        pose.block<3, 1>(0, 2) = forward;
+        pose.block<3, 1>(0, 3) = position;
+        return pose;
+    }
+
+    void addDrift() {
+        std::normal_distribution<float> noise(0.0f, config.drift);
+        mat4f delta = mat4f::Identity();
+        delta.block<3, 3>(0, 0) = (Eigen::AngleAxisf(noise(rng), vec3f::UnitX()) *
+                                   Eigen::AngleAxisf(noise(rng), vec3f::UnitY()) *
+                                   Eigen::AngleAxisf(noise(rng), vec3f::UnitZ())).toRotationMatrix();
+        delta.block<3, 1>(0, 3) = vec3f(noise(rng), noise(rng), noise(rng));
+        drift = drift * delta;
+    }
+
+    // points seen from the keyframe at 1.5 to 6 m, colored by depth
+    void observe(SlamStep& step) {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> depth(1.5f, 6.0f);
+        step.points.resize(config.points_per_keyframe);
+        step.colors.resize(config.points_per_keyframe);
+        for (size_t i = 0; i < config.points_per_keyframe; ++i) {
+            float z = depth(rng);
+            step.points[i] = vec3f(unit(rng) * 0.7f * z, unit(rng) * 0.5f * z, z);
+            float t = (z - 1.5f) / 4.5f;
+            step.colors[i] = vec4f(1.0f - t, 0.4f + 0.3f * unit(rng), t, 1.0f);
+        }
+    }
+
+    void optimize(SlamStep& step) {
+        size_t count = std::max<size_t>(1, size_t(keyframes.size() * config.optimize_fraction));
+        for (size_t i = keyframes.size() - count; i < keyframes.size(); ++i)
+            step.corrected.emplace_back(i, keyframes[i]);
+        drift = mat4f::Identity();
+        step.pose = keyframes.back();
+    }
+
+    // moving stripes, enough to keep texture uploads honest
+    void render(SlamStep& step) {
+        Image& image = step.image;
+        image = Image(config.image_width, config.image_height, 3);
+        uint8_t* p = image.ptr();
+        for (int y = 0; y < image.height; ++y) {
+            for (int x = 0; x < image.width; ++x, p += 3) {
+                int v = int(x + 2 * step.frame) ^ y;
+                p[0] = uint8_t(v);
+                p[1] = uint8_t(v >> 1);
+                p[2] = uint8_t(128 + y / 2);
+            }
+        }
+    }
+
+    Config config;
+    std::mt19937 rng;
+    uint64_t frame = 0;
+    mat4f drift;                        // estimated keyframe to true keyframe
+    std::vector<mat4f> keyframes;       // true poses
+};
+
+// The scene of a SLAM session as the viewer draws it: map points and the
+// trajectory anchored to the keyframes, a frustum per keyframe, the current
+// camera and its image as a texture. Steps are applied on the render thread.
+class SlamScene: public BaseRenderer {
+public:
+    SlamScene() {
+        map.setPoseBuffer(&poses);
+        trajectory.setPoseBuffer(&poses);
+        frustums.setPoseBuffer(&poses);
+        camera.add(mat4f::Identity(), vec4f(1.0f, 1.0f, 0.6f, 0.45f), COLOR_RED, 0.2f);
+    }
+
+    // "anchored" and "frustum" shaders from the sources in `dir`, needs a current context
+    void loadShaders(const std::string& dir) {
+        anchoredShader = std::make_shared<Shader>((dir + "/draw_anchored.vert").c_str(), (dir + "/draw_point.frag").c_str());
+        frustumShader = std::make_shared<Shader>((dir + "/draw_frustum.vert").c_str(), (dir + "/draw_point.frag").c_str());
+    }
+
+    // render thread
+    void apply(const SlamStep& step) {
+        if (step.keyframe) {
+            poses.set(step.keyframe_index, step.pose);
+            map.append(step.points, step.colors, GLuint(step.keyframe_index));
+            trajectory.appendKeyframe(GLuint(step.keyframe_index), COLOR_GREEN);
+            frustums.add(mat4f::Identity(), vec4f(1.0f, 1.0f, 0.6f, 0.45f), COLOR_BLUE, 0.1f);
+        }
+        for (const auto& [index, pose] : step.corrected)
+            poses.set(index, pose);
+        camera.setPose(0, step.pose);
+
+        if (!step.image.empty()) {
+            if (!image)
+                image = std::make_unique<ImageTexture>(GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE);
+            image->setup(const_cast<uint8_t*>(step.image.ptr()), vec2i(step.image.width, step.image.height));
+        }
+    }
+
+    void render(const Viewport& viewport) override {
+        if (!anchoredShader || poses.size() == 0)
+            return;
+        map.draw(anchoredShader.get(), viewport);
+        trajectory.draw(anchoredShader.get(), viewport);
+        frustums.draw(frustumShader.get(), viewport);
+        camera.draw(frustumShader.get(), viewport);
+    }
+
+    // latest camera image, nullptr before the first one
+    const ImageTexture* getImage() const {
+        return image.get();
+    }
+
+private:
+    PoseBuffer poses;
+    AnchoredPointCloud map;
+    AnchoredLine trajectory;
+    FrustumSet frustums;
+    FrustumSet camera;
+    std::unique_ptr<ImageTexture> image;
+    std::shared_ptr<Shader> anchoredShader;
+    std::shared_ptr<Shader> frustumShader;
+};
+
+// Feeds a SlamWorkload to a SlamScene through a viewer's post(), either from
+// its own thread at the workload's rate or stepped by the caller, which keeps
+// runs reproducible frame by frame:
+//
+//     auto scene = std::make_shared<SlamScene>();
+//     SlamDriver driver(scene, [&](UpdateQueue::Command c){ viewer.post(std::move(c)); });
+//     driver.start();
+//
+// The time from generating a step to applying it on the render thread is kept
+// as the update latency.
+class SlamDriver {
+public:
+    using Post = std::function<void(UpdateQueue::Command)>;
+
+    SlamDriver(std::shared_ptr<SlamScene> scene, Post post, const SlamWorkload::Config& config = SlamWorkload::Config()):
+        scene(std::move(scene)), post(std::move(post)), workload(config), latency(std::make_shared<Latency>()) {}
+
+    SlamDriver(const SlamDriver&) = delete;
+    SlamDriver& operator=(const SlamDriver&) = delete;
+
+    ~SlamDriver() {
+        stop();
+    }
+
+    // false without a positive rate to pace the thread with
+    bool start() {
+        if (thread.joinable())
+            return true;
+        double rate = workload.getConfig().rate;
+        if (!(rate > 0.0) || !std::isfinite(rate)) {
+            std::cerr << "Invalid SLAM step rate " << rate << ", expected a positive number of steps per second" << std::endl;
+            return false;
+        }
+        running = true;
+        thread = std::thread([this, rate]() {
+            auto period = std::chrono::duration<double>(1.0 / rate);
+            auto next = std::chrono::steady_clock::now();
+            while (running) {
+                step();
+                next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+                std::this_thread::sleep_until(next);
+            }
+        });
+        return true;
+    }
+
+    void stop() {
+        running = false;
+        if (thread.joinable())
+            thread.join();
+    }
+
+    // generate and post the next `count` steps on the calling thread
+    void step(size_t count = 1) {
+        for (size_t i = 0; i < count; ++i) {
+            // commands may run after the driver is gone, so they hold what they touch
+            auto next = std::make_shared<SlamStep>(workload.next());
+            post([scene = scene, latency = latency, next]() {
+                scene->apply(*next);
+                float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - next->created).count();
+                std::lock_guard<std::mutex> lock(latency->mutex);
+                latency->history.push(ms, 1000);
+            });
+            ++posted;
+        }
+    }
+
+    size_t getPosted() const {
+        return posted;
+    }
+
+    // update latency in ms over the last 1000 steps
+    FrameProfiler::Stats getLatency() const {
+        std::lock_guard<std::mutex> lock(latency->mutex);
+        return latency->history.stats();
+    }
+
+private:
+    struct Latency {
+        std::mutex mutex;
+        FrameProfiler::History history;
+    };
+
+    std::shared_ptr<SlamScene> scene;
+    Post post;
+    SlamWorkload workload;      // producer thread only once started
+
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<size_t> posted{0};
+    std::shared_ptr<Latency> latency;
+};
+
+} // namespace liteviz
+
+#endif // __LITEVIZ_WORKLOAD_H__
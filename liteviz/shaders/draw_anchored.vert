@@ -0,0 +1,27 @@
+#version 430
+
+layout(std430, binding = 0) readonly buffer Poses {
+    mat4 poses[];       // keyframe to world, see PoseBuffer
+};
+
+uniform mat4 ProjMat;
+uniform float PointSize;
+uniform int PoseCount;  // poses set in the PoseBuffer, the SSBO past them is uninitialized
+in vec3 Position;       // in the frame of the anchor keyframe
+in vec4 Color;
+in uint Anchor;         // keyframe index into poses
+out vec3 Frag_Position;
+out vec4 Frag_Color;
+
+void main() {
+    if (Anchor >= uint(PoseCount)) {
+        // keyframe pose not set yet, leave the vertex outside the clip volume
+        gl_Position = vec4(2, 2, 2, 1);
+        return;
+    }
+    vec4 position = poses[Anchor] * vec4(Position, 1);
+    Frag_Position = position.xyz;
+    Frag_Color = Color;
+    gl_Position = ProjMat * position;
+    gl_PointSize = PointSize;
+}
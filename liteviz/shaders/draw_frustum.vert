@@ -0,0 +1,25 @@
+#version 430
+
+layout(std430, binding = 0) readonly buffer Poses {
+    mat4 poses[];       // keyframe to world, see PoseBuffer
+};
+
+uniform mat4 ProjMat;
+uniform int Anchored;   // instance i is attached to keyframe i, Pose is relative to it
+in vec4 Position;       // canonical frustum vertex, w = 1 for the axis gizmo
+in vec4 Color;          // axis gizmo colors
+in mat4 Pose;           // per instance, camera to world or to its keyframe
+in vec4 Intrinsics;     // per instance, (fx, fy, cx, cy) times the frustum scale
+in vec4 InstanceColor;  // per instance
+out vec3 Frag_Position;
+out vec4 Frag_Color;
+
+void main() {
+    bool axis = Position.w > 0.5;
+    vec3 extent = axis ? vec3(Intrinsics.z) : Intrinsics.zwx;
+    mat4 pose = Anchored != 0 ? poses[gl_InstanceID] * Pose : Pose;
+    vec4 position = pose * vec4(Position.xyz * extent, 1);
+    Frag_Position = position.xyz;
+    Frag_Color = axis ? Color : InstanceColor;
+    gl_Position = ProjMat * position;
+}
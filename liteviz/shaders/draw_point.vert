@@ -2,14 +2,18 @@
 
 uniform mat4 ProjMat;
 uniform float PointSize;
+// dequantization of fixed point positions, identity for float ones
+uniform vec3 PositionOffset = vec3(0.0);
+uniform vec3 PositionScale = vec3(1.0);
 in vec3 Position;
 in vec4 Color;
 out vec3 Frag_Position;
 out vec4 Frag_Color;
 
 void main() {
-    Frag_Position = Position;
+    vec3 position = PositionOffset + PositionScale * Position;
+    Frag_Position = position;
     Frag_Color = Color;
-    gl_Position = ProjMat * vec4(Position, 1);
+    gl_Position = ProjMat * vec4(position, 1);
     gl_PointSize = PointSize;
 }
\ No newline at end of file